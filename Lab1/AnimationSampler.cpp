@@ -0,0 +1,83 @@
+#include "stdafx.h"
+#include "AnimationSampler.h"
+
+
+AnimationSampler::AnimationSampler() : hits(0), misses(0), frames(0), cacheSize(0)
+{
+}
+
+AnimationSampler::AnimationSampler(GLuint frameCount, const SampleFunction& sample, GLuint cacheSize)
+	: hits(0), misses(0), frames(frameCount), evaluate(sample), cacheSize(cacheSize)
+{
+	cache.reserve(cacheSize);
+}
+
+Pose AnimationSampler::sample(GLuint frame)
+{
+	if (frames == 0) return Pose();
+	if (frame >= frames) frame = frames - 1;
+	if (baked.size() == frames) return baked[frame];
+	if (keyframes.frameCount() == frames) return keyframes.sample(frame);
+
+	// the cache is a handful of poses, a linear search beats any lookup structure
+	for (size_t k = 0; k < cache.size(); k++) {
+		if (cache[k].frame != frame) continue;
+		CachedPose pose = cache[k];
+		for (size_t m = k; m > 0; m--)
+			cache[m] = cache[m - 1];
+		cache[0] = pose;
+		hits++;
+		return pose.pose;
+	}
+
+	misses++;
+	CachedPose pose = { frame, evaluate(frame) };
+	if (cacheSize == 0) return pose.pose;
+	// drop the least recently used pose once the cache is full
+	if (cache.size() < cacheSize)
+		cache.push_back(pose);
+	for (size_t m = cache.size() - 1; m > 0; m--)
+		cache[m] = cache[m - 1];
+	cache[0] = pose;
+	return pose.pose;
+}
+
+Pose AnimationSampler::interpolate(GLfloat frame, GLboolean loop)
+{
+	if (frames == 0) return Pose();
+	if (loop)
+		frame -= glm::floor(frame / frames) * frames;
+	else
+		frame = glm::clamp(frame, 0.0f, (GLfloat)(frames - 1));
+	GLuint first = glm::min((GLuint)frame, frames - 1);
+	GLuint next = first + 1 < frames ? first + 1 : (loop ? 0 : first);
+	GLfloat t = frame - first;
+	if (t <= 0 || next == first) return sample(first);
+	return KeyframeTrack::interpolate(sample(first), sample(next), t);
+}
+
+void AnimationSampler::bake(GLboolean quantized)
+{
+	baked = PoseTrack(quantized);
+	baked.reserve(frames);
+	for (GLuint f = 0; f < frames; f++)
+		baked.push_back(evaluate(f));
+	keyframes = KeyframeTrack();
+	cache.clear();
+}
+
+void AnimationSampler::compress(GLfloat positionTolerance, GLfloat angleTolerance)
+{
+	PoseTrack poses;
+	poses.reserve(frames);
+	for (GLuint f = 0; f < frames; f++)
+		poses.push_back(evaluate(f));
+	keyframes = KeyframeTrack(poses, positionTolerance, angleTolerance);
+	baked = PoseTrack();
+	cache.clear();
+}
+
+size_t AnimationSampler::bytes() const
+{
+	return cache.capacity() * sizeof(CachedPose) + baked.bytes() + keyframes.bytes();
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <GL/glut.h>
+#include <glm/glm.hpp>
+
+// plays an animation by elapsed time instead of by counting rendered frames
+// the animation frame at time now is (now - start) * framesPerSecond, usually fractional, and
+// AnimationSampler::interpolate blends the frames around it, so the motion keeps its timing
+// whether it is drawn at 30, 60 or 144 frames per second, or draws are skipped under load
+// times are seconds from any clock the caller uses (glfwGetTime, GLUT_ELAPSED_TIME, a simulation)
+class PlaybackClock {
+public:
+	// animation frames per second of playback
+	GLdouble framesPerSecond;
+
+	PlaybackClock(GLdouble framesPerSecond) : framesPerSecond(framesPerSecond), startTime(0), running(false) {}
+
+	// play from frame 0 at time now
+	GLvoid start(GLdouble now) {
+		startTime = now;
+		running = true;
+	}
+	GLboolean started() const {
+		return running;
+	}
+	// animation frame at time now, 0 before start()
+	GLfloat frame(GLdouble now) const {
+		return running ? (GLfloat)glm::max((now - startTime) * framesPerSecond, 0.0) : 0.0f;
+	}
+
+private:
+	GLdouble startTime;
+	GLboolean running;
+};
@@ -0,0 +1,102 @@
+#include "stdafx.h"
+#include "PoseTrack.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+
+Pose::Pose() : translation(0.0f), rotation(1.0f, 0.0f, 0.0f, 0.0f)
+{
+}
+
+Pose::Pose(glm::vec3 translation, glm::quat rotation) : translation(translation), rotation(rotation)
+{
+}
+
+glm::mat4 Pose::matrix() const
+{
+	glm::mat4 m = glm::mat4_cast(rotation);
+	m[3] = glm::vec4(translation, 1.0f);
+	return m;
+}
+
+PoseTrack::PoseTrack() : quantized(false)
+{
+}
+
+PoseTrack::PoseTrack(GLboolean quantized) : quantized(quantized)
+{
+}
+
+void PoseTrack::push_back(const Pose& pose)
+{
+	if (quantized)
+		quantizedPoses.push_back(encode(pose));
+	else
+		poses.push_back(pose);
+}
+
+void PoseTrack::reserve(size_t n)
+{
+	if (quantized)
+		quantizedPoses.reserve(n);
+	else
+		poses.reserve(n);
+}
+
+void PoseTrack::clear()
+{
+	poses.clear();
+	quantizedPoses.clear();
+}
+
+size_t PoseTrack::bytes() const
+{
+	return poses.capacity() * sizeof(Pose) + quantizedPoses.capacity() * sizeof(QuantizedPose);
+}
+
+Pose PoseTrack::operator[](size_t frame) const
+{
+	return quantized ? decode(quantizedPoses[frame]) : poses[frame];
+}
+
+// components other than the largest lie in [-1 / sqrt(2), 1 / sqrt(2)], mapped to 15 bits
+static const GLfloat QUAT_RANGE = 0.70710678f;
+static const GLfloat QUAT_STEPS = 32767.0f;
+
+// smallest three: q and -q are the same rotation, so the largest component is made
+// positive and can be recomputed from the other three
+PoseTrack::QuantizedPose PoseTrack::encode(const Pose& pose)
+{
+	glm::quat q = glm::normalize(pose.rotation);
+	GLuint largest = 0;
+	for (GLuint c = 1; c < 4; c++) {
+		if (glm::abs(q[c]) > glm::abs(q[largest]))
+			largest = c;
+	}
+	if (q[largest] < 0)
+		q = -q;
+
+	QuantizedPose result;
+	result.translation = pose.translation;
+	for (GLuint c = 0, k = 0; c < 4; c++) {
+		if (c == largest) continue;
+		GLfloat unit = glm::clamp((q[c] + QUAT_RANGE) / (2.0f * QUAT_RANGE), 0.0f, 1.0f);
+		result.rotation[k++] = (GLushort)((GLuint)(unit * QUAT_STEPS + 0.5f) << 1);
+	}
+	result.rotation[0] |= largest & 1;
+	result.rotation[1] |= (largest >> 1) & 1;
+	return result;
+}
+
+Pose PoseTrack::decode(const QuantizedPose& pose)
+{
+	GLuint largest = (pose.rotation[0] & 1) | ((pose.rotation[1] & 1) << 1);
+	glm::quat q;
+	GLfloat sum = 0;
+	for (GLuint c = 0, k = 0; c < 4; c++) {
+		if (c == largest) continue;
+		q[c] = (pose.rotation[k++] >> 1) / QUAT_STEPS * (2.0f * QUAT_RANGE) - QUAT_RANGE;
+		sum += q[c] * q[c];
+	}
+	q[largest] = glm::sqrt(glm::max(0.0f, 1.0f - sum));
+	return Pose(pose.translation, q);
+}
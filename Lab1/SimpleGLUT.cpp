@@ -17,6 +17,10 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/ext.hpp>
 
+#include "SplineCurve.h"
+#include "AnimationSampler.h"
+#include "PlaybackClock.h"
+
 //================================
 // global variables
 //================================
@@ -24,188 +28,86 @@
 int g_screenWidth  = 0;
 int g_screenHeight = 0;
 
-// frame index
-int g_frameIndex = 0;
+// animation clock, one frame per 16 ms timer tick as the animation was made for
+PlaybackClock playback(1000.0 / 16);
 
 // dt defaulted to 0.01
 GLfloat dt = 0.01;
 
-// vector of Transformation Matrices for each frame of interpolation
-std::vector<glm::mat4> transformMatrices;
+// pose of each frame of interpolation, evaluated when the frame is shown
+AnimationSampler animation;
+// number of recently shown frames the animation keeps
+const GLuint POSE_CACHE_SIZE = 4;
 // intermediate matrix
 glm::mat4 transformMat;
 
 
-GLfloat catmullRom(GLfloat p0, GLfloat p1, GLfloat p2, GLfloat p3, GLfloat t) {
-	GLdouble t2 = t * t;
-	GLdouble t3 = t2 * t;
-	return ((2 * p1) +
-		(-p0 + p2) * t +
-		(2 * p0 - 5 * p1 + 4 * p2 - p3) * t2 +
-		(-p0 + 3 * p1 - 3 * p2 + p3) * t3) * 0.5;
-}
-
-GLfloat bSpline(GLfloat p0, GLfloat p1, GLfloat p2, GLfloat p3, GLfloat t) {
-	GLdouble t2 = t * t;
-	GLdouble t3 = t2 * t;
-	GLfloat MArray[16] = { 
-		-1/6.0, 3/6.0, -3/6.0, 1/6.0,
-		3/6.0, -6/6.0, 3/6.0, 0,
-		-3/6.0, 0, 3/6.0, 0,
-		1/6.0, 4/6.0, 1/6.0, 0
-	};
-	glm::vec4 T(t3, t2, t, 1);
-	glm::mat4 M = glm::transpose(glm::make_mat4(MArray));
-	glm::vec4 P(p0, p1, p2, p3);
-
-	GLfloat result = glm::dot(T * M, P);
-	return result;
+// number of frames, one per dt along a curve of segments segments
+GLuint frameCount(GLuint segments) {
+	GLuint count = 0;
+	for (float i = 0; i < segments; i += dt)
+		count++;
+	return count;
 }
 
-void eulerOperations(GLint interpolationMode) {
-
-	GLfloat positionArray[12] = {-10,0,-20,-5,-5,-20,5,5,-20,10,0,-20}; 
-	glm::mat4x3 controlPointsPos = glm::make_mat4x3(positionArray);
-
-	GLfloat eulerOriArray[12] = {-180,0,0,-90,-90,0,90,90,0,180,0,0};
-	glm::mat4x3 controlPointsOri = glm::make_mat4x3(eulerOriArray);
-
-	GLfloat xi, yi, zi;
-	GLfloat rolli, yawi, pitchi;
-
-	if (interpolationMode == 1) {
-		for (float i = 0; i < 1; i += dt) {
-
-			// compute catmull-rom interpolation for position
-			xi = catmullRom(controlPointsPos[0][0], controlPointsPos[1][0], controlPointsPos[2][0], controlPointsPos[3][0], i);
-			yi = catmullRom(controlPointsPos[0][1], controlPointsPos[1][1], controlPointsPos[2][1], controlPointsPos[3][1], i);
-			zi = catmullRom(controlPointsPos[0][2], controlPointsPos[1][2], controlPointsPos[2][2], controlPointsPos[3][2], i);
-			glm::vec3 posTransform(xi, yi, zi);
-
-			// compute calmull-rom interpolation for orientation
-			rolli = catmullRom(controlPointsOri[0][0], controlPointsOri[1][0], controlPointsOri[2][0], controlPointsOri[3][0], i);
-			yawi = catmullRom(controlPointsOri[0][1], controlPointsOri[1][1], controlPointsOri[2][1], controlPointsOri[3][1], i);
-			pitchi = catmullRom(controlPointsOri[0][2], controlPointsOri[1][2], controlPointsOri[2][2], controlPointsOri[3][2], i);
-
-			// compute 4x4 transformation matrix 
-			glm::mat4 transformMatrix(1.0f); // identity matrix 
-			transformMatrix = glm::translate(transformMatrix, posTransform);
-			transformMatrix = glm::rotate(transformMatrix, glm::radians(yawi), glm::vec3(0, 1, 0));
-			transformMatrix = glm::rotate(transformMatrix, glm::radians(pitchi), glm::vec3(0, 0, 1));
-			transformMatrix = glm::rotate(transformMatrix, glm::radians(rolli), glm::vec3(1, 0, 0));
-
-			// push result into vector for return
-			transformMatrices.push_back(transformMatrix);
-		}
-	}
-	else if (interpolationMode == 2) {
-		for (float i = 0; i < 1; i += dt) {
-
-			// compute bSpline interpolation for position
-			xi = bSpline(controlPointsPos[0][0], controlPointsPos[1][0], controlPointsPos[2][0], controlPointsPos[3][0], i);
-			yi = bSpline(controlPointsPos[0][1], controlPointsPos[1][1], controlPointsPos[2][1], controlPointsPos[3][1], i);
-			zi = bSpline(controlPointsPos[0][2], controlPointsPos[1][2], controlPointsPos[2][2], controlPointsPos[3][2], i);
-			glm::vec3 posTransform(xi, yi, zi);
-
-			// compute bSpline interpolation for orientation
-			rolli = bSpline(controlPointsOri[0][0], controlPointsOri[1][0], controlPointsOri[2][0], controlPointsOri[3][0], i);
-			yawi = bSpline(controlPointsOri[0][1], controlPointsOri[1][1], controlPointsOri[2][1], controlPointsOri[3][1], i);
-			pitchi = bSpline(controlPointsOri[0][2], controlPointsOri[1][2], controlPointsOri[2][2], controlPointsOri[3][2], i);
-
-			// compute 4x4 transformation matrix 
-			glm::mat4 transformMatrix(1.0f); // identity matrix 
-			transformMatrix = glm::translate(transformMatrix, posTransform);
-			transformMatrix = glm::rotate(transformMatrix, glm::radians(yawi), glm::vec3(0, 1, 0));
-			transformMatrix = glm::rotate(transformMatrix, glm::radians(pitchi), glm::vec3(0, 0, 1));
-			transformMatrix = glm::rotate(transformMatrix, glm::radians(rolli), glm::vec3(1, 0, 0));
-
-			// push result into vector for return
-			transformMatrices.push_back(transformMatrix);
-		}
-	}
-	else {
-		exit(1);
-	}
+template <class Basis>
+void eulerOperations() {
+
+	// any number of control points, one curve segment per point after the first three
+	GLfloat positionArray[] = {-10,0,-20,-5,-5,-20,5,5,-20,10,0,-20}; 
+	GLfloat eulerOriArray[] = {-180,0,0,-90,-90,0,90,90,0,180,0,0};
+
+	SplineCurve<Basis> position(positionArray, sizeof(positionArray) / (3 * sizeof(GLfloat)));
+	SplineCurve<Basis> orientation(eulerOriArray, sizeof(eulerOriArray) / (3 * sizeof(GLfloat)));
+
+	animation = AnimationSampler(frameCount(position.segmentCount()), [=](GLuint frame) {
+		// compute interpolation for position and orientation of the frame
+		GLfloat t;
+		GLuint s = position.locate(frame * dt, t);
+		glm::vec3 posTransform = position.position(s, t);
+		glm::vec3 eulerAngles = orientation.position(s, t);
+		GLfloat rolli = eulerAngles.x;
+		GLfloat yawi = eulerAngles.y;
+		GLfloat pitchi = eulerAngles.z;
+
+		// rotate about y, then z, then x
+		glm::quat rotation = glm::angleAxis(glm::radians(yawi), glm::vec3(0, 1, 0))
+			* glm::angleAxis(glm::radians(pitchi), glm::vec3(0, 0, 1))
+			* glm::angleAxis(glm::radians(rolli), glm::vec3(1, 0, 0));
+		return Pose(posTransform, rotation);
+	}, POSE_CACHE_SIZE);
 	
 }
-void quaternionOperations(GLint interpolationMode) {
+template <class Basis>
+void quaternionOperations() {
 
-	GLfloat positionArray[12] = { -10,0,-20,-5,-5,-20,5,5,-20,10,0,-20 };
-	glm::mat4x3 controlPointsPos = glm::make_mat4x3(positionArray);
+	GLfloat positionArray[] = { -10,0,-20,-5,-5,-20,5,5,-20,10,0,-20 };
 
-	GLfloat eulerOriArray[12] = { -180,0,0,-90,-90,0,90,90,0,180,0,0 };
-	glm::mat4x3 controlPointsOri = glm::make_mat4x3(eulerOriArray);
+	GLfloat eulerOriArray[] = { -180,0,0,-90,-90,0,90,90,0,180,0,0 };
+	const GLuint pointCount = sizeof(eulerOriArray) / (3 * sizeof(GLfloat));
 
-	// convert euler to quaternion
-	std::vector<glm::quat> quaternions;
-	for (int k = 0; k < 4; k++) {
-		glm::vec3 eulerAngles = glm::radians(controlPointsOri[k]);
+	// convert euler to quaternion, stored as x, y, z, w
+	GLfloat quaternionArray[4 * pointCount];
+	for (GLuint k = 0; k < pointCount; k++) {
+		glm::vec3 eulerAngles = glm::radians(glm::make_vec3(eulerOriArray + 3 * k));
 		glm::quat q = glm::quat(eulerAngles);
-		quaternions.push_back(q);
+		for (int c = 0; c < 4; c++)
+			quaternionArray[k * 4 + c] = q[c];
 	}
 
-	// intermediate variables
-	GLfloat xi, yi, zi;
-	GLfloat wq, xq, yq, zq;
-	
+	SplineCurve<Basis> position(positionArray, sizeof(positionArray) / (3 * sizeof(GLfloat)));
+	SplineCurve<Basis> orientation(quaternionArray, pointCount, SPLINE_OPEN, 4);
 
-	if (interpolationMode == 1) {
-		for (float i = 0; i < 1; i += dt) {
-
-			// compute catmull-rom interpolation for position
-			xi = catmullRom(controlPointsPos[0][0], controlPointsPos[1][0], controlPointsPos[2][0], controlPointsPos[3][0], i);
-			yi = catmullRom(controlPointsPos[0][1], controlPointsPos[1][1], controlPointsPos[2][1], controlPointsPos[3][1], i);
-			zi = catmullRom(controlPointsPos[0][2], controlPointsPos[1][2], controlPointsPos[2][2], controlPointsPos[3][2], i);
-			glm::vec3 posTransform(xi, yi, zi);
-
-			// compute calmull-rom interpolation for orientation
-			xq = catmullRom(quaternions[0][0], quaternions[1][0], quaternions[2][0], quaternions[3][0], i);
-			yq = catmullRom(quaternions[0][1], quaternions[1][1], quaternions[2][1], quaternions[3][1], i);
-			zq = catmullRom(quaternions[0][2], quaternions[1][2], quaternions[2][2], quaternions[3][2], i);
-			wq = catmullRom(quaternions[0][3], quaternions[1][3], quaternions[2][3], quaternions[3][3], i);
-			glm::quat quaternion(wq, xq, yq, zq);
-			quaternion = glm::normalize(quaternion);
-
-			// compute 4x4 transformation matrix 
-			glm::mat4 transformMatrix(1.0f); // identity matrix 
-			transformMatrix = glm::translate(transformMatrix, posTransform);
-			glm::mat4 rotationMatrix = glm::toMat4(quaternion);
-			transformMatrix = transformMatrix * rotationMatrix;
-
-			// push result into vector for return
-			transformMatrices.push_back(transformMatrix);
-		}
-	}
-	else if (interpolationMode == 2) {
-		for (float i = 0; i < 1; i += dt) {
-
-			// compute bSpline interpolation for position
-			xi = bSpline(controlPointsPos[0][0], controlPointsPos[1][0], controlPointsPos[2][0], controlPointsPos[3][0], i);
-			yi = bSpline(controlPointsPos[0][1], controlPointsPos[1][1], controlPointsPos[2][1], controlPointsPos[3][1], i);
-			zi = bSpline(controlPointsPos[0][2], controlPointsPos[1][2], controlPointsPos[2][2], controlPointsPos[3][2], i);
-			glm::vec3 posTransform(xi, yi, zi);
-
-			// compute bSpline interpolation for orientation
-			xq = bSpline(quaternions[0][0], quaternions[1][0], quaternions[2][0], quaternions[3][0], i);
-			yq = bSpline(quaternions[0][1], quaternions[1][1], quaternions[2][1], quaternions[3][1], i);
-			zq = bSpline(quaternions[0][2], quaternions[1][2], quaternions[2][2], quaternions[3][2], i);
-			wq = bSpline(quaternions[0][3], quaternions[1][3], quaternions[2][3], quaternions[3][3], i);
-			glm::quat quaternion(wq, xq, yq, zq);
-			quaternion = glm::normalize(quaternion);
-
-			// compute 4x4 transformation matrix 
-			glm::mat4 transformMatrix(1.0f); // identity matrix 
-			transformMatrix = glm::translate(transformMatrix, posTransform);
-			glm::mat4 rotationMatrix = glm::toMat4(quaternion);
-			transformMatrix = transformMatrix * rotationMatrix;
-
-			// push result into vector for return
-			transformMatrices.push_back(transformMatrix);
-		}
-	}
-	else {
-		exit(1);
-	}
+	animation = AnimationSampler(frameCount(position.segmentCount()), [=](GLuint frame) {
+		// compute interpolation for position and orientation of the frame
+		GLfloat t;
+		GLuint s = position.locate(frame * dt, t);
+		glm::vec3 posTransform = position.position(s, t);
+		const SplineBatch& q = orientation.segment(s);
+		glm::quat quaternion(q.value(3, t), q.value(0, t), q.value(1, t), q.value(2, t));
+		quaternion = glm::normalize(quaternion);
+		return Pose(posTransform, quaternion);
+	}, POSE_CACHE_SIZE);
 
 }
 
@@ -223,11 +125,20 @@ void init( void ) {
 	std::cout << "Enter dt:" << "\n";
 	std::cin >> dt;
 
+	if (interpolationMode != 1 && interpolationMode != 2) {
+		exit(1);
+	}
 	if (orientationMode == 1) {
-		eulerOperations(interpolationMode);
+		if (interpolationMode == 1)
+			eulerOperations<CatmullRomBasis>();
+		else
+			eulerOperations<BSplineBasis>();
 	}
 	else if (orientationMode == 2) {
-		quaternionOperations(interpolationMode);
+		if (interpolationMode == 1)
+			quaternionOperations<CatmullRomBasis>();
+		else
+			quaternionOperations<BSplineBasis>();
 	}
 	else {
 		exit(1);
@@ -239,13 +150,10 @@ void init( void ) {
 // update
 //================================
 void update( void ) {
-	// update the transformation matrix for each frame
-	if (g_frameIndex < transformMatrices.size()) {
-		transformMat = transformMatrices[g_frameIndex];
-	}
-	else {
-		transformMat = transformMatrices[transformMatrices.size() - 1];
-	}
+	// update the transformation matrix to the time since the animation started, so it keeps its
+	// speed when timer ticks come late, the last frame stays once the animation ended
+	GLdouble now = glutGet(GLUT_ELAPSED_TIME) / 1000.0;
+	transformMat = animation.interpolate(playback.frame(now), false).matrix();
 	
 
 }
@@ -335,9 +243,6 @@ void reshape( int w, int h ) {
 // timer : triggered every 16ms ( about 60 frames per second )
 //================================
 void timer( int value ) {	
-	// increase frame index
-	g_frameIndex++;
-
 	update();
 	
 	// render
@@ -367,6 +272,9 @@ int main( int argc, char** argv ) {
 	glutReshapeFunc( reshape );
 	glutKeyboardFunc( keyboard );
 	glutTimerFunc( 16, timer, 0 );
+
+	// start the animation clock once the settings are entered
+	playback.start(glutGet(GLUT_ELAPSED_TIME) / 1000.0);
 	
 	// main loop
 	glutMainLoop();
@@ -0,0 +1,34 @@
+#pragma once
+#include <GL/glut.h>
+
+// one segment of a cubic spline with the basis matrix already applied to its control points
+// evaluates up to 4 components (e.g. x, y, z of a position or x, y, z, w of a quaternion)
+// for many parameter values at once, 4 (SSE) or 8 (AVX) values per instruction
+class SplineBatch {
+public:
+	static const GLuint MAX_COMPONENTS = 4;
+
+	// basis matrices, row-major, applied as T * M * P with T = (t^3, t^2, t, 1)
+	static const GLfloat CATMULL_ROM[16];
+	static const GLfloat B_SPLINE[16];
+
+	// points: 4 control points of components floats each, stored one after another
+	SplineBatch(const GLfloat* basis, const GLfloat* points, GLuint components);
+
+	// values[c][i] and tangents[c][i] receive component c of the spline and its derivative at t[i]
+	// tangents may be NULL
+	GLvoid evaluate(const GLfloat* t, GLuint count, GLfloat* const* values, GLfloat* const* tangents) const;
+
+	// component c of the spline and of its derivative at a single t
+	GLfloat value(GLuint c, GLfloat t) const {
+		return ((coeff[c][0] * t + coeff[c][1]) * t + coeff[c][2]) * t + coeff[c][3];
+	}
+	GLfloat tangent(GLuint c, GLfloat t) const {
+		return (3 * coeff[c][0] * t + 2 * coeff[c][1]) * t + coeff[c][2];
+	}
+
+private:
+	GLuint components;
+	// per component, coefficients of t^3, t^2, t and 1
+	GLfloat coeff[MAX_COMPONENTS][4];
+};
@@ -0,0 +1,156 @@
+#pragma once
+#include <GL/glut.h>
+#include <glm/glm.hpp>
+#include <cassert>
+#include <vector>
+#include "SplineBatch.h"
+
+// basis matrices of SplineCurve, selected at compile time
+struct CatmullRomBasis {
+	static const GLfloat* matrix() { return SplineBatch::CATMULL_ROM; }
+};
+struct BSplineBasis {
+	static const GLfloat* matrix() { return SplineBatch::B_SPLINE; }
+};
+
+// how a SplineCurve treats the ends of its control points
+enum SplineMode {
+	SPLINE_OPEN,	// n - 3 segments, the first and last point only shape the curve
+	SPLINE_CLOSED,	// n segments, the last point connects back to the first
+	SPLINE_CLAMPED	// n - 1 segments from the first to the last point, with mirrored end points added
+};
+
+// cubic spline through any number of control points of up to 4 components (e.g. x, y, z of a
+// position or x, y, z, w of a quaternion), segment s is shaped by points s ... s + 3
+// the basis is applied to every segment once when the curve is built, so a sample only
+// evaluates one cubic in Horner form per component
+// a global parameter u runs from 0 to segmentCount(), segment floor(u) at t = u - floor(u)
+template <class Basis>
+class SplineCurve {
+public:
+	// points: pointCount control points of components floats each, 1 <= components <= 4
+	// pointCount must be at least minimumPoints(mode), so the curve has a segment
+	SplineCurve(const GLfloat* points, GLuint pointCount, SplineMode mode = SPLINE_OPEN, GLuint components = 3)
+		: mode(mode), components(components) {
+		assert(components >= 1 && components <= SplineBatch::MAX_COMPONENTS);
+		assert(pointCount >= minimumPoints(mode));
+		GLuint n = pointCount;
+		GLuint c = components;
+		// lay out the points so the 4 points of every segment follow each other
+		if (mode == SPLINE_CLAMPED && n >= 2) {
+			// mirror the second and the second to last point, Catmull-Rom and B-spline then
+			// both start at the first and end at the last point
+			for (GLuint k = 0; k < c; k++)
+				controls.push_back(2 * points[k] - points[c + k]);
+			controls.insert(controls.end(), points, points + n * c);
+			for (GLuint k = 0; k < c; k++)
+				controls.push_back(2 * points[(n - 1) * c + k] - points[(n - 2) * c + k]);
+		}
+		else {
+			controls.assign(points, points + n * c);
+			if (mode == SPLINE_CLOSED && n >= 3)
+				controls.insert(controls.end(), points, points + 3 * c);
+		}
+
+		GLuint count = (GLuint)controls.size() / c;
+		for (GLuint s = 0; s + 3 < count; s++)
+			segments.push_back(SplineBatch(Basis::matrix(), &controls[s * c], c));
+	}
+
+	// fewest control points giving one segment: 4 open, 3 closed, 2 clamped
+	static GLuint minimumPoints(SplineMode mode) {
+		return mode == SPLINE_OPEN ? 4 : (mode == SPLINE_CLOSED ? 3 : 2);
+	}
+
+	GLuint segmentCount() const {
+		return (GLuint)segments.size();
+	}
+	GLuint componentCount() const {
+		return components;
+	}
+	SplineMode endMode() const {
+		return mode;
+	}
+	// coefficients of one segment, for evaluating many t at once
+	const SplineBatch& segment(GLuint s) const {
+		return segments[s];
+	}
+	// the 4 control points shaping segment s, one after another, including added end points
+	const GLfloat* controlPoints(GLuint s) const {
+		return &controls[s * components];
+	}
+
+	// segment and t at global parameter u, closed curves wrap around, open ones are clamped
+	GLuint locate(GLfloat u, GLfloat& t) const {
+		GLfloat count = (GLfloat)segments.size();
+		if (mode == SPLINE_CLOSED)
+			u -= glm::floor(u / count) * count;
+		u = glm::clamp(u, 0.0f, count);
+		GLint s = glm::min((GLint)u, (GLint)segments.size() - 1);
+		t = u - s;
+		return s;
+	}
+
+	// position and derivative at t in [0, 1] of segment s
+	glm::vec3 position(GLuint s, GLfloat t) const {
+		const SplineBatch& c = segments[s];
+		return glm::vec3(c.value(0, t), c.value(1, t), c.value(2, t));
+	}
+	glm::vec3 tangent(GLuint s, GLfloat t) const {
+		const SplineBatch& c = segments[s];
+		return glm::vec3(c.tangent(0, t), c.tangent(1, t), c.tangent(2, t));
+	}
+	// component c at global parameter u
+	GLfloat value(GLuint c, GLfloat u) const {
+		GLfloat t;
+		GLuint s = locate(u, t);
+		return segments[s].value(c, t);
+	}
+
+	// values[c][i] and tangents[c][i] receive component c of the curve and its derivative with
+	// respect to u at the global parameter u[i], tangents may be NULL
+	// when there are several parameters per segment on average, consecutive parameters within one
+	// segment are evaluated together 4 or 8 at a time, so sorted parameters (e.g. actors ordered
+	// along the path) run fastest; sparse parameters are evaluated one by one, as searching for
+	// runs of one or two would cost more than it saves
+	GLvoid evaluate(const GLfloat* u, GLuint count, GLfloat* const* values, GLfloat* const* tangents) const {
+		if (segments.empty()) return;
+		const GLuint RUN = 64;
+		GLfloat t[RUN];
+		if (count < 8 * segments.size()) {
+			for (GLuint i = 0; i < count; i++) {
+				const SplineBatch& segment = segments[locate(u[i], t[0])];
+				for (GLuint c = 0; c < components; c++) {
+					values[c][i] = segment.value(c, t[0]);
+					if (tangents)
+						tangents[c][i] = segment.tangent(c, t[0]);
+				}
+			}
+			return;
+		}
+
+		GLfloat* runValues[SplineBatch::MAX_COMPONENTS];
+		GLfloat* runTangents[SplineBatch::MAX_COMPONENTS];
+		GLuint i = 0;
+		while (i < count) {
+			GLuint s = locate(u[i], t[0]);
+			GLuint length = 1;
+			while (i + length < count && length < RUN && locate(u[i + length], t[length]) == s)
+				length++;
+			for (GLuint c = 0; c < components; c++) {
+				runValues[c] = values[c] + i;
+				if (tangents)
+					runTangents[c] = tangents[c] + i;
+			}
+			segments[s].evaluate(t, length, runValues, tangents ? runTangents : NULL);
+			i += length;
+		}
+	}
+
+private:
+	std::vector<SplineBatch> segments;
+	// control points including the added end points, segment s starts at controls[s * components]
+	std::vector<GLfloat> controls;
+	SplineMode mode;
+	GLuint components;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <functional>
+#include <vector>
+#include "PoseTrack.h"
+#include "KeyframeTrack.h"
+
+// an animated transformation evaluated from its curves when a frame is shown,
+// instead of a matrix baked for every frame up front
+// the cacheSize most recently sampled frames are kept, so a frame shown more than once
+// (a finished animation, several objects on one track) is evaluated once
+// where evaluating is expensive, bake() stores the pose of every frame instead, or
+// compress() only the keyframes needed to reproduce them within a tolerance
+class AnimationSampler {
+public:
+	typedef std::function<Pose(GLuint frame)> SampleFunction;
+
+	// number of samples answered from the cache and evaluated
+	size_t hits;
+	size_t misses;
+
+	AnimationSampler();
+	// track of frameCount frames, sample(frame) evaluates frame 0 ... frameCount - 1
+	// cacheSize 0 evaluates every sample
+	AnimationSampler(GLuint frameCount, const SampleFunction& sample, GLuint cacheSize);
+
+	GLuint frameCount() const {
+		return frames;
+	}
+	// pose at frame, frames past the end give the last frame
+	Pose sample(GLuint frame);
+	// pose at a fractional frame, interpolated between the two frames around it
+	// a looping track wraps frame around and blends the last frame into the first
+	Pose interpolate(GLfloat frame, GLboolean loop);
+
+	// evaluate every frame once and answer samples from the stored poses from now on
+	void bake(GLboolean quantized);
+	// evaluate every frame once, keep the keyframes that reproduce them within positionTolerance
+	// and angleTolerance (radians) and answer samples from the keyframes from now on
+	void compress(GLfloat positionTolerance, GLfloat angleTolerance);
+	// memory taken by the cache and the baked poses
+	size_t bytes() const;
+
+private:
+	struct CachedPose {
+		GLuint frame;
+		Pose pose;
+	};
+
+	GLuint frames;
+	SampleFunction evaluate;
+	GLuint cacheSize;
+	// most recently used first
+	std::vector<CachedPose> cache;
+	// every frame after bake(), empty before
+	PoseTrack baked;
+	// keyframes after compress(), empty before
+	KeyframeTrack keyframes;
+};
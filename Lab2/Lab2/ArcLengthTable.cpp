@@ -0,0 +1,72 @@
+#include "ArcLengthTable.h"
+
+
+// nodes and weights of 5-point Gauss-Legendre quadrature on [-1, 1], exact for polynomials up to degree 9
+static const GLdouble GAUSS_NODES[5] = { -0.9061798459386640, -0.5384693101056831, 0.0, 0.5384693101056831, 0.9061798459386640 };
+static const GLdouble GAUSS_WEIGHTS[5] = { 0.2369268850561891, 0.4786286704993665, 0.5688888888888889, 0.4786286704993665, 0.2369268850561891 };
+
+static GLfloat speed(const SplineBatch& c, GLfloat t)
+{
+	return glm::length(glm::vec3(c.tangent(0, t), c.tangent(1, t), c.tangent(2, t)));
+}
+
+ArcLengthTable::ArcLengthTable() : segments(0), total(0), inverseSpacing(0), lastEntry(0)
+{
+}
+
+GLfloat ArcLengthTable::measure(const SplineBatch& c, GLfloat t0, GLfloat t1)
+{
+	GLdouble half = 0.5 * (t1 - t0);
+	GLdouble mid = 0.5 * (t1 + t0);
+	GLdouble sum = 0;
+	for (GLint k = 0; k < 5; k++)
+		sum += GAUSS_WEIGHTS[k] * speed(c, (GLfloat)(mid + half * GAUSS_NODES[k]));
+	return (GLfloat)(sum * half);
+}
+
+GLvoid ArcLengthTable::build(const std::vector<SplineBatch>& curve, GLuint entriesPerSegment)
+{
+	segments = (GLuint)curve.size();
+	parameter.clear();
+	total = 0;
+	inverseSpacing = 0;
+	lastEntry = 0;
+	if (segments == 0 || entriesPerSegment == 0) return;
+
+	// arc length at t = k / n of every segment, accumulated over the whole curve
+	GLuint n = entriesPerSegment;
+	std::vector<GLdouble> arc(1, 0.0);
+	for (GLuint s = 0; s < segments; s++)
+		for (GLuint k = 0; k < n; k++)
+			arc.push_back(arc.back() + measure(curve[s], (GLfloat)k / n, (GLfloat)(k + 1) / n));
+	total = (GLfloat)arc.back();
+
+	// walk the intervals once and place an entry every length / entries
+	GLuint entries = segments * n;
+	GLdouble spacing = arc.back() / entries;
+	inverseSpacing = (GLfloat)(1.0 / spacing);
+	parameter.resize(entries + 1);
+	lastEntry = (GLint)entries - 1;
+	GLuint i = 0;
+	for (GLuint j = 0; j < entries; j++) {
+		GLdouble d = j * spacing;
+		while (i + 1 < entries && arc[i + 1] <= d)
+			i++;
+		GLuint s = i / n;
+		GLfloat t0 = (GLfloat)(i % n) / n;
+		GLfloat t1 = (GLfloat)(i % n + 1) / n;
+
+		// guess by linear interpolation inside the interval, then correct with Newton steps on
+		// the integrated length, staying inside the interval
+		GLdouble width = arc[i + 1] - arc[i];
+		GLfloat t = width > 0 ? t0 + (GLfloat)((d - arc[i]) / width) * (t1 - t0) : t0;
+		for (GLint step = 0; step < 2; step++) {
+			GLfloat v = speed(curve[s], t);
+			if (v <= 0) break;
+			t -= (GLfloat)((arc[i] + measure(curve[s], t0, t) - d) / v);
+			t = glm::clamp(t, t0, t1);
+		}
+		parameter[j] = s + t;
+	}
+	parameter[entries] = (GLfloat)segments;
+}
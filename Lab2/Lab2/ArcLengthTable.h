@@ -0,0 +1,58 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "SplineBatch.h"
+
+// maps distance along a spline curve to the segment and parameter t at that distance
+// the arc length of every segment is integrated with 5-point Gauss-Legendre quadrature when
+// the table is built, then the curve is resampled at equal distances, so a lookup is one
+// indexed linear interpolation instead of a search or a root find
+class ArcLengthTable {
+public:
+	ArcLengthTable();
+	// entriesPerSegment: resolution of the table, the curve gets this many entries per segment
+	template <class Curve>
+	ArcLengthTable(const Curve& curve, GLuint entriesPerSegment) {
+		std::vector<SplineBatch> segments;
+		for (GLuint s = 0; s < curve.segmentCount(); s++)
+			segments.push_back(curve.segment(s));
+		build(segments, entriesPerSegment);
+	}
+
+	// length of the whole curve
+	GLfloat length() const {
+		return total;
+	}
+	GLuint segmentCount() const {
+		return segments;
+	}
+	// memory taken by the table
+	size_t bytes() const {
+		return parameter.size() * sizeof(GLfloat);
+	}
+
+	// segment and t in [0, 1] at distance from the start, clamped to the ends of the curve
+	GLvoid locate(GLfloat distance, GLuint& segment, GLfloat& t) const {
+		GLfloat x = glm::clamp(distance, 0.0f, total) * inverseSpacing;
+		GLint j = glm::min((GLint)x, lastEntry);
+		GLfloat u = parameter[j] + (x - j) * (parameter[j + 1] - parameter[j]);
+		GLint s = glm::min((GLint)u, (GLint)segments - 1);
+		segment = s;
+		t = u - s;
+	}
+
+	// arc length of one segment between t0 and t1
+	static GLfloat measure(const SplineBatch& c, GLfloat t0, GLfloat t1);
+
+private:
+	// curve parameter (segment + t) at distance j * length() / (parameter.size() - 1)
+	std::vector<GLfloat> parameter;
+	GLuint segments;
+	GLfloat total;
+	GLfloat inverseSpacing;
+	// index of the last entry a lookup interpolates from
+	GLint lastEntry;
+
+	GLvoid build(const std::vector<SplineBatch>& curve, GLuint entriesPerSegment);
+};
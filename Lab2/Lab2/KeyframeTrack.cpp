@@ -0,0 +1,98 @@
+#include "KeyframeTrack.h"
+#include <algorithm>
+
+
+KeyframeTrack::KeyframeTrack() : segment(0)
+{
+}
+
+KeyframeTrack::KeyframeTrack(const PoseTrack& poses, GLfloat positionTolerance, GLfloat angleTolerance) : segment(0)
+{
+	GLuint count = (GLuint)poses.size();
+	if (count == 0) return;
+	// two unit quaternions are within angle of each other if |dot| >= cos(angle / 2)
+	GLfloat minCosHalfAngle = glm::cos(0.5f * angleTolerance);
+
+	GLuint start = 0;
+	frames.push_back(0);
+	keys.push_back(poses[0]);
+	while (start + 1 < count) {
+		// grow the segment in doubling steps until it fails, then bisect between the last
+		// length that fit and the first that did not; a segment of two frames always fits
+		GLuint good = start + 1;
+		GLuint bad = count;
+		for (GLuint length = 2; start + length < count; length *= 2) {
+			if (!fits(poses, start, start + length, positionTolerance, minCosHalfAngle)) {
+				bad = start + length;
+				break;
+			}
+			good = start + length;
+		}
+		if (bad == count && good != count - 1) {
+			if (fits(poses, start, count - 1, positionTolerance, minCosHalfAngle))
+				good = count - 1;
+			else
+				bad = count - 1;
+		}
+		while (bad - good > 1) {
+			GLuint mid = good + (bad - good) / 2;
+			if (fits(poses, start, mid, positionTolerance, minCosHalfAngle))
+				good = mid;
+			else
+				bad = mid;
+		}
+		frames.push_back(good);
+		keys.push_back(poses[good]);
+		start = good;
+	}
+	frames.shrink_to_fit();
+	keys.shrink_to_fit();
+}
+
+// true if interpolating from frame first to frame last reproduces every frame in between
+GLboolean KeyframeTrack::fits(const PoseTrack& poses, GLuint first, GLuint last, GLfloat positionTolerance, GLfloat minCosHalfAngle)
+{
+	Pose a = poses[first];
+	Pose b = poses[last];
+	GLfloat span = (GLfloat)(last - first);
+	for (GLuint f = first + 1; f < last; f++) {
+		Pose pose = poses[f];
+		Pose approximation = interpolate(a, b, (f - first) / span);
+		if (glm::distance(approximation.translation, pose.translation) > positionTolerance)
+			return false;
+		if (glm::abs(glm::dot(approximation.rotation, pose.rotation)) < minCosHalfAngle)
+			return false;
+	}
+	return true;
+}
+
+Pose KeyframeTrack::interpolate(const Pose& a, const Pose& b, GLfloat t)
+{
+	// q and -q are the same rotation, blend towards the one on the same side as a
+	glm::quat q = b.rotation;
+	if (glm::dot(a.rotation, q) < 0)
+		q = -q;
+	return Pose(glm::mix(a.translation, b.translation, t), glm::normalize(a.rotation * (1 - t) + q * t));
+}
+
+size_t KeyframeTrack::bytes() const
+{
+	return frames.capacity() * sizeof(GLuint) + keys.capacity() * sizeof(Pose);
+}
+
+Pose KeyframeTrack::sample(GLuint frame)
+{
+	if (keys.empty()) return Pose();
+	if (frame >= frames.back()) return keys.back();
+
+	// playback mostly stays in the same segment or moves on to the next one
+	if (frame < frames[segment] || frame >= frames[segment + 1]) {
+		if (segment + 2 < frames.size() && frame >= frames[segment + 1] && frame < frames[segment + 2])
+			segment++;
+		else
+			segment = (GLuint)(std::upper_bound(frames.begin(), frames.end(), frame) - frames.begin()) - 1;
+	}
+	GLuint first = frames[segment];
+	GLuint last = frames[segment + 1];
+	return interpolate(keys[segment], keys[segment + 1], (GLfloat)(frame - first) / (last - first));
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "PoseTrack.h"
+
+// a pose track reduced to the keys needed to reproduce every frame within a tolerance
+// between two keys the translation is interpolated linearly and the rotation by normalized lerp
+// nearly collinear runs of frames collapse into one segment, so a long clip shrinks to a few keys
+class KeyframeTrack {
+public:
+	KeyframeTrack();
+	// keep frame 0, then repeatedly the farthest frame whose segment still reproduces all frames
+	// in between within positionTolerance (distance) and angleTolerance (radians)
+	KeyframeTrack(const PoseTrack& poses, GLfloat positionTolerance, GLfloat angleTolerance);
+
+	size_t keyCount() const {
+		return keys.size();
+	}
+	// number of frames of the original track
+	GLuint frameCount() const {
+		return frames.empty() ? 0 : frames.back() + 1;
+	}
+	// memory taken by the keys
+	size_t bytes() const;
+
+	// pose at frame, frames past the end give the last key
+	// the segment of the previous call is tried first, then the one after it
+	Pose sample(GLuint frame);
+
+	static Pose interpolate(const Pose& a, const Pose& b, GLfloat t);
+
+private:
+	// frame of every key, ascending, kept apart from the poses so lookups touch little memory
+	std::vector<GLuint> frames;
+	std::vector<Pose> keys;
+	// segment of the last sample, from keys[segment] to keys[segment + 1]
+	GLuint segment;
+
+	static GLboolean fits(const PoseTrack& poses, GLuint first, GLuint last, GLfloat positionTolerance, GLfloat minCosHalfAngle);
+};
@@ -5,12 +5,22 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/constants.hpp>
+#include <glm/gtc/random.hpp>
 
 #include "Shader.h"
 #include "Camera.h"
 #include "Model.h"
+#include "SplineBatch.h"
+#include "SplineCurve.h"
+#include "ArcLengthTable.h"
+#include "AnimationSampler.h"
+#include "PlaybackClock.h"
 
 #include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cfloat>
+#include <algorithm>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
 
@@ -26,8 +36,15 @@ glm::quat euler2quat(glm::vec3 eularAngles);
 glm::mat4 quat2mat4(glm::quat q);
 
 GLfloat lerp(GLfloat p0, GLfloat p1, GLfloat t);
-GLvoid quaternionOperations(GLfloat(*splineFunc)(GLfloat, GLfloat, GLfloat, GLfloat, GLfloat, GLboolean), GLint segment);
-GLvoid legMotion();
+Pose torsoPose(glm::vec3 position, glm::vec3 tangent);
+template <class Basis> AnimationSampler torsoMotion();
+AnimationSampler legMotion();
+GLvoid benchmarkSpline();
+GLvoid benchmarkSampling();
+GLvoid benchmarkArcLength();
+GLvoid benchmarkCrowd(GLuint actors, GLuint points);
+GLvoid benchmarkPlayback();
+GLvoid walkPoses(GLfloat frame, glm::mat4& torsoMat, glm::mat4& legLMat, glm::mat4& legRMat);
 
 // settings
 const GLuint SCR_WIDTH = 800;
@@ -47,14 +64,22 @@ GLfloat lastFrame = 0.0f;
 // dt default
 GLfloat dt = 0.001;
 
+// walk the path at constant speed instead of in equal steps of the spline parameter
+GLboolean constantSpeed = false;
+// entries per path segment of the arc-length table
+const GLuint ARC_LENGTH_ENTRIES = 256;
+
 // frame index
 GLint frameCount = 0;
-GLint animFrameCount = -1;
+// animation clock, one frame per rendered frame at 60 Hz as the animation was made for
+PlaybackClock playback(60);
 
-// vector of Transformation Matrices for each frame of interpolation
-std::vector<glm::mat4> torsoAnim; // torso
-std::vector<glm::mat4> legAnim; // leg
-size_t legAnimOffset = 0;
+// pose of each frame of interpolation, evaluated when the frame is shown
+AnimationSampler torsoAnim; // torso
+AnimationSampler legAnim; // leg
+GLuint legAnimOffset = 0;
+// number of recently shown frames each track keeps, the legs share one track
+const GLuint POSE_CACHE_SIZE = 4;
 
 // control points 
 GLfloat positionArray[24] = { // positions
@@ -67,6 +92,7 @@ GLfloat positionArray[24] = { // positions
 	 9.0,  0, -9,
 	 9.0,  0,  9
 };
+const GLuint PATH_POINTS = sizeof(positionArray) / (3 * sizeof(GLfloat));
 
 // lighting
 glm::vec3 lightPos(0.0f, 10.0f, 10.0f);
@@ -80,18 +106,20 @@ GLvoid init(GLvoid) {
 	GLint splineMode = 1;
 	std::cout << "Select interpolation mode: \n 1: Catmull-Rom \n 2: B-Spline" << "\n";
 	std::cin >> splineMode;
+	GLint speedMode = 1;
+	std::cout << "Select speed: \n 1: spline parameter \n 2: constant" << "\n";
+	std::cin >> speedMode;
+	constantSpeed = speedMode == 2;
 	/*   std::cout << "Enter dt:" << "\n";
 	   std::cin >> dt;*/
 
-	// calculate animation frames
-	legMotion();
+	// set up the animation tracks, frames are evaluated when they are shown
+	legAnim = legMotion();
 	if (splineMode == 1) {
-		for (size_t i = 0; i < 5; i++)
-			quaternionOperations(catmullRom, i);
+		torsoAnim = torsoMotion<CatmullRomBasis>();
 	}
 	else if (splineMode == 2) {
-		for (size_t i = 0; i < 5; i++)
-			quaternionOperations(bSpline, i);
+		torsoAnim = torsoMotion<BSplineBasis>();
 	}
 	else {
 		exit(1);
@@ -100,8 +128,34 @@ GLvoid init(GLvoid) {
 
 }
 
-GLint main()
+GLint main(GLint argc, char** argv)
 {
+	// "Lab2 bench" compares the batched spline evaluation with the scalar functions
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		benchmarkSpline();
+		return 0;
+	}
+	// "Lab2 sampling" compares sampling frames when they are shown with baking poses up front
+	if (argc > 1 && strcmp(argv[1], "sampling") == 0) {
+		benchmarkSampling();
+		return 0;
+	}
+	// "Lab2 arclength" compares walking in equal parameter steps with walking at constant speed
+	if (argc > 1 && strcmp(argv[1], "arclength") == 0) {
+		benchmarkArcLength();
+		return 0;
+	}
+	// "Lab2 crowd [actors] [points]" moves many actors along one long closed path
+	if (argc > 1 && strcmp(argv[1], "crowd") == 0) {
+		benchmarkCrowd(argc > 2 ? (GLuint)strtoul(argv[2], NULL, 10) : 10000, argc > 3 ? (GLuint)strtoul(argv[3], NULL, 10) : 5000);
+		return 0;
+	}
+	// "Lab2 playback" plays the walk at several frame rates with a frame counter and with the clock
+	if (argc > 1 && strcmp(argv[1], "playback") == 0) {
+		benchmarkPlayback();
+		return 0;
+	}
+
 	init();
 	// glfw: initialize and configure
 	// ------------------------------
@@ -146,6 +200,7 @@ GLint main()
 	// -------------------------
 	Shader modelShader("model.vs", "model.fs");
 	Shader floorShader("background.vs", "background.fs");
+	GLint modelLoc = modelShader.location("model");
 
 	// load models
 	// -----------
@@ -236,39 +291,31 @@ GLint main()
 		modelShader.setMat4("view", view);
 
 
-		// update the transformation matrix for each frame
+		// update the transformation matrices to the time since the animation started, so the walk
+		// keeps its speed at any frame rate, the last frame stays before the start and after the end
 		glm::mat4 torsoMat, legLMat, legRMat;
-		if (animFrameCount >= 0 && animFrameCount < torsoAnim.size()) {
-			torsoMat = torsoAnim[animFrameCount];
-			legLMat = torsoMat * legAnim[animFrameCount % legAnim.size()];
-			legRMat = torsoMat * legAnim[(animFrameCount + legAnimOffset) % legAnim.size()];
-			animFrameCount++;
-		}
-		else {
-			GLint lastframe = torsoAnim.size() - 1;
-			torsoMat = torsoAnim[lastframe];
-			legLMat = torsoMat * legAnim[lastframe % legAnim.size()];
-			legRMat = torsoMat * legAnim[(lastframe + legAnimOffset) % legAnim.size()];
-		}
+		GLfloat lastframe = (GLfloat)(torsoAnim.frameCount() - 1);
+		GLfloat animFrame = playback.started() ? glm::min(playback.frame(glfwGetTime()), lastframe) : lastframe;
+		walkPoses(animFrame, torsoMat, legLMat, legRMat);
 
 		// draw the torso
 		glm::mat4 torsoModel;
 		torsoModel = glm::scale(torsoMat, glm::vec3(0.5f, 0.2f, 0.5f));
 		torsoModel = glm::translate(torsoModel, glm::vec3(0, 10, 0));
-		modelShader.setMat4("model", torsoModel);
+		modelShader.setMat4(modelLoc, torsoModel);
 		myModel.Draw(modelShader);
 
 		// draw left leg
 		glm::mat4 legLModel = legLMat;
 		legLModel = glm::translate(legLModel, glm::vec3(.5, 0, 0));
 		legLModel = glm::scale(legLModel, glm::vec3(0.2f, 0.4f, 0.2f));
-		modelShader.setMat4("model", legLModel);
+		modelShader.setMat4(modelLoc, legLModel);
 		myModel.Draw(modelShader);
 		// draw right leg
 		glm::mat4 legRModel = legRMat;
 		legRModel = glm::translate(legRModel, glm::vec3(-.5, 0, 0));
 		legRModel = glm::scale(legRModel, glm::vec3(0.2f, 0.4f, 0.2f));
-		modelShader.setMat4("model", legRModel);
+		modelShader.setMat4(modelLoc, legRModel);
 		myModel.Draw(modelShader);
 
 		// draw floor
@@ -313,7 +360,7 @@ GLvoid processInput(GLFWwindow* window)
 
 	// press SPACE to start animation
 	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
-		animFrameCount = 0;
+		playback.start(glfwGetTime());
 
 }
 
@@ -458,47 +505,380 @@ glm::mat4 quat2mat4(glm::quat q) {
 	return glm::transpose(glm::make_mat4(mat4array));
 }
 
-// calculate spline for 4 control points
-GLvoid quaternionOperations(GLfloat (*splineFunc)(GLfloat, GLfloat, GLfloat, GLfloat, GLfloat, GLboolean), GLint segment) {
-
-	GLfloat* tempCtrlPos = positionArray + segment * 3;
-
-	glm::mat4x3 controlPointsPos = glm::make_mat4x3(tempCtrlPos);
-
-	// intermediate variables
-	GLfloat xi, yi, zi;
-	GLfloat angle;
-
-	for (GLfloat i = 0; i < 1; i += dt) {
-
-		// compute catmull-rom interpolation for position
-		glm::vec3 posTransform;
-		xi = splineFunc(controlPointsPos[0][0], controlPointsPos[1][0], controlPointsPos[2][0], controlPointsPos[3][0], i, false);
-		yi = splineFunc(controlPointsPos[0][1], controlPointsPos[1][1], controlPointsPos[2][1], controlPointsPos[3][1], i, false);
-		zi = splineFunc(controlPointsPos[0][2], controlPointsPos[1][2], controlPointsPos[2][2], controlPointsPos[3][2], i, false);
-		posTransform.x = xi;
-		posTransform.y = yi;
-		posTransform.z = zi;
-
-		// calculate tangent along the spline to set facing direction
-		glm::quat quaternion = glm::normalize(quaternion);
-		GLfloat tanx = splineFunc(controlPointsPos[0][0], controlPointsPos[1][0], controlPointsPos[2][0], controlPointsPos[3][0], i, true);
-		GLfloat tanz = splineFunc(controlPointsPos[0][2], controlPointsPos[1][2], controlPointsPos[2][2], controlPointsPos[3][2], i, true);
-		angle = vector2angle(tanx, tanz);
-
-		// compute 4x4 transformation matrix 
-		glm::mat4 transformMatrix(1.0f);
-		// translation 
-		transformMatrix = glm::translate(transformMatrix, posTransform);
-		// rotation
-		quaternion = euler2quat(glm::vec3(0, angle, 0));
-		glm::mat4 rotationMatrix = quat2mat4(quaternion);
-		transformMatrix = transformMatrix * rotationMatrix;
-
-		// push result into vector for return
-		torsoAnim.push_back(transformMatrix);
+// number of steps i = 0, step, 2 step, ... below 1
+GLuint stepCount(GLfloat step) {
+	GLuint count = 0;
+	for (GLfloat i = 0; i < 1; i += step)
+		count++;
+	return count;
+}
+
+// torso track along the whole walk path, one frame per dt of every segment
+// the basis of every segment is applied once when the track is set up
+// at constant speed the same number of frames is spread evenly over the length of the path
+template <class Basis>
+AnimationSampler torsoMotion() {
+	SplineCurve<Basis> path(positionArray, PATH_POINTS);
+	GLuint framesPerSegment = stepCount(dt);
+	GLuint frames = path.segmentCount() * framesPerSegment;
+	if (constantSpeed) {
+		ArcLengthTable arcLength(path, ARC_LENGTH_ENTRIES);
+		GLfloat stride = arcLength.length() / frames;
+		return AnimationSampler(frames, [=](GLuint frame) {
+			GLuint segment;
+			GLfloat t;
+			arcLength.locate(frame * stride, segment, t);
+			return torsoPose(path.position(segment, t), path.tangent(segment, t));
+		}, POSE_CACHE_SIZE);
+	}
+	return AnimationSampler(frames, [=](GLuint frame) {
+		GLuint segment = frame / framesPerSegment;
+		GLfloat t = (frame % framesPerSegment) * dt;
+		return torsoPose(path.position(segment, t), path.tangent(segment, t));
+	}, POSE_CACHE_SIZE);
+}
+
+// torso and leg matrices at a fractional frame of the walk, the legs swing in a loop
+GLvoid walkPoses(GLfloat frame, glm::mat4& torsoMat, glm::mat4& legLMat, glm::mat4& legRMat) {
+	torsoMat = torsoAnim.interpolate(frame, false).matrix();
+	legLMat = torsoMat * legAnim.interpolate(frame, true).matrix();
+	legRMat = torsoMat * legAnim.interpolate(frame + legAnimOffset, true).matrix();
+}
+
+// torso pose at a point of the walk path
+Pose torsoPose(glm::vec3 position, glm::vec3 tangent) {
+
+	// tangent along the spline sets facing direction
+	GLfloat angle = vector2angle(tangent.x, tangent.z);
+	return Pose(position, euler2quat(glm::vec3(0, angle, 0)));
+}
+
+// sample position and tangent of one segment of path one t at a time, repeats times
+// out receives x, y, z and the tangent x, y, z of all samples one after another, returns the seconds taken
+template <class Basis>
+GLdouble timeCurveSamples(const SplineCurve<Basis>& path, GLuint segment, const std::vector<GLfloat>& t, GLuint repeats, std::vector<GLfloat>& out) {
+	GLuint count = (GLuint)t.size();
+	auto start = std::chrono::steady_clock::now();
+	for (GLuint r = 0; r < repeats; r++) {
+		for (GLuint k = 0; k < count; k++) {
+			glm::vec3 p = path.position(segment, t[k]);
+			glm::vec3 v = path.tangent(segment, t[k]);
+			for (GLint c = 0; c < 3; c++) {
+				out[c * count + k] = p[c];
+				out[(3 + c) * count + k] = v[c];
+			}
+		}
+	}
+	return std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - start).count();
+}
+
+// time position and tangent of the walk path at dt = 0.001
+// per-scalar catmullRom/bSpline calls against one SplineBatch pass per segment and
+// against single samples of a SplineCurve built once
+GLvoid benchmarkSpline() {
+	const GLuint REPEATS = 200;
+	const GLfloat* bases[2] = { SplineBatch::CATMULL_ROM, SplineBatch::B_SPLINE };
+	GLfloat(*scalarFuncs[2])(GLfloat, GLfloat, GLfloat, GLfloat, GLfloat, GLboolean) = { catmullRom, bSpline };
+	const char* names[2] = { "Catmull-Rom", "B-Spline" };
+
+	std::vector<GLfloat> t;
+	for (GLfloat i = 0; i < 1; i += 0.001f)
+		t.push_back(i);
+	GLuint count = (GLuint)t.size();
+
+	SplineCurve<CatmullRomBasis> catmullRomPath(positionArray, PATH_POINTS);
+	SplineCurve<BSplineBasis> bSplinePath(positionArray, PATH_POINTS);
+	const GLuint SEGMENTS = catmullRomPath.segmentCount();
+
+	std::vector<GLfloat> scalar(count * 6), batch(count * 6), curve(count * 6);
+	std::cout << "spline\t\tscalar ns/sample\tbatch ns/sample\tspeedup\tcurve ns/sample\tspeedup\tmax difference\n";
+	for (GLint b = 0; b < 2; b++) {
+		GLdouble scalarTime = 0, batchTime = 0, curveTime = 0, maxDiff = 0;
+		for (GLuint segment = 0; segment < SEGMENTS; segment++) {
+			const GLfloat* p = catmullRomPath.controlPoints(segment);
+
+			auto start = std::chrono::steady_clock::now();
+			for (GLuint r = 0; r < REPEATS; r++) {
+				for (GLuint k = 0; k < count; k++) {
+					for (GLint c = 0; c < 3; c++) {
+						scalar[c * count + k] = scalarFuncs[b](p[c], p[3 + c], p[6 + c], p[9 + c], t[k], false);
+						scalar[(3 + c) * count + k] = scalarFuncs[b](p[c], p[3 + c], p[6 + c], p[9 + c], t[k], true);
+					}
+				}
+			}
+			auto mid = std::chrono::steady_clock::now();
+			for (GLuint r = 0; r < REPEATS; r++) {
+				GLfloat* values[3] = { &batch[0], &batch[count], &batch[2 * count] };
+				GLfloat* tangents[3] = { &batch[3 * count], &batch[4 * count], &batch[5 * count] };
+				SplineBatch spline(bases[b], p, 3);
+				spline.evaluate(t.data(), count, values, tangents);
+			}
+			auto end = std::chrono::steady_clock::now();
+
+			curveTime += b == 0 ? timeCurveSamples(catmullRomPath, segment, t, REPEATS, curve)
+				: timeCurveSamples(bSplinePath, segment, t, REPEATS, curve);
+
+			scalarTime += std::chrono::duration<GLdouble>(mid - start).count();
+			batchTime += std::chrono::duration<GLdouble>(end - mid).count();
+			for (size_t k = 0; k < scalar.size(); k++) {
+				maxDiff = glm::max(maxDiff, (GLdouble)glm::abs(scalar[k] - batch[k]));
+				maxDiff = glm::max(maxDiff, (GLdouble)glm::abs(scalar[k] - curve[k]));
+			}
+		}
+		GLdouble samples = (GLdouble)SEGMENTS * REPEATS * count;
+		std::cout << names[b] << "\t" << scalarTime / samples * 1E9 << "\t\t\t" << batchTime / samples * 1E9
+			<< "\t\t" << scalarTime / batchTime << "x\t" << curveTime / samples * 1E9
+			<< "\t\t" << scalarTime / curveTime << "x\t" << maxDiff << "\n";
+	}
+}
+
+// for dt from 0.01 to 0.0001: set up the Catmull-Rom walk, then play it like the render loop
+// (torso and both legs every frame, then 100 frames standing at the end) with every frame
+// sampled on demand, baked as poses, baked as quantized poses and reduced to keyframes
+// within 0.001 units and 0.1 degrees
+// the 4x4 matrices the tracks held before are given for comparison, max error is the
+// largest difference of a matrix element between quantized and exact poses
+GLvoid benchmarkSampling() {
+	const GLfloat steps[3] = { 0.01f, 0.001f, 0.0001f };
+	GLfloat defaultDt = dt;
+	std::cout << "dt\tframes\tmat4 KB\tmode\t\tKB\tsetup ms\tplayback ms\tcache hits\tmax error\n";
+	for (GLint k = 0; k < 3; k++) {
+		dt = steps[k];
+		const char* modes[4] = { "on demand", "poses", "quantized", "keyframes" };
+		std::vector<glm::mat4> exact;
+		for (GLint mode = 0; mode < 4; mode++) {
+			auto start = std::chrono::steady_clock::now();
+			torsoAnim = torsoMotion<CatmullRomBasis>();
+			legAnim = legMotion();
+			if (mode == 1 || mode == 2) {
+				torsoAnim.bake(mode == 2);
+				legAnim.bake(mode == 2);
+			}
+			else if (mode == 3) {
+				torsoAnim.compress(0.001f, glm::radians(0.1f));
+				legAnim.compress(0.001f, glm::radians(0.1f));
+			}
+			GLdouble setupTime = std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - start).count();
+
+			// matrices are composed at draw time
+			GLuint frames = torsoAnim.frameCount();
+			std::vector<glm::mat4> drawn(3 * (frames + 100));
+			start = std::chrono::steady_clock::now();
+			for (GLuint f = 0; f < frames + 100; f++) {
+				GLuint frame = f < frames ? f : frames - 1;
+				glm::mat4 torsoMat = torsoAnim.sample(frame).matrix();
+				drawn[3 * f] = torsoMat;
+				drawn[3 * f + 1] = torsoMat * legAnim.sample(frame % legAnim.frameCount()).matrix();
+				drawn[3 * f + 2] = torsoMat * legAnim.sample((frame + legAnimOffset) % legAnim.frameCount()).matrix();
+			}
+			GLdouble playbackTime = std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - start).count();
+
+			GLfloat maxError = 0;
+			if (mode == 0)
+				exact = drawn;
+			for (size_t m = 0; m < drawn.size(); m++)
+				for (GLint c = 0; c < 4; c++)
+					maxError = glm::max(maxError, glm::length(drawn[m][c] - exact[m][c]));
+			size_t hits = torsoAnim.hits + legAnim.hits;
+			size_t samples = hits + torsoAnim.misses + legAnim.misses;
+			size_t matrixBytes = (torsoAnim.frameCount() + legAnim.frameCount()) * sizeof(glm::mat4);
+
+			std::cout << dt << "\t" << frames << "\t" << matrixBytes / 1024.0 << "\t" << modes[mode]
+				<< "\t" << (torsoAnim.bytes() + legAnim.bytes()) / 1024.0 << "\t" << setupTime * 1000.0
+				<< "\t\t" << playbackTime * 1000.0 << "\t\t" << 100.0 * hits / glm::max(samples, (size_t)1) << "%"
+				<< "\t\t" << maxError << "\n";
+		}
 	}
+	dt = defaultDt;
+}
+
+// for both bases at dt = 0.001: the spread of the distance walked per frame in equal parameter
+// steps and at constant speed, the time to build the arc-length table and to sample a position
+// per frame either way, and the largest distance error of the table against quadrature
+// with the exact parameter
+GLvoid benchmarkArcLength() {
+	const GLuint REPEATS = 200;
+	const char* names[2] = { "Catmull-Rom", "B-Spline" };
+	SplineCurve<CatmullRomBasis> catmullRomPath(positionArray, PATH_POINTS);
+	SplineCurve<BSplineBasis> bSplinePath(positionArray, PATH_POINTS);
+	std::cout << "spline\t\tlength\ttable KB\tbuild ms\tparameter step min/max\tconstant step min/max\tparameter ns/sample\tconstant ns/sample\tmax error\n";
+	for (GLint b = 0; b < 2; b++) {
+		std::vector<SplineBatch> segments;
+		for (GLuint s = 0; s < catmullRomPath.segmentCount(); s++)
+			segments.push_back(b == 0 ? catmullRomPath.segment(s) : bSplinePath.segment(s));
+		auto position = [&](GLuint s, GLfloat t) {
+			return glm::vec3(segments[s].value(0, t), segments[s].value(1, t), segments[s].value(2, t));
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		ArcLengthTable table = b == 0 ? ArcLengthTable(catmullRomPath, ARC_LENGTH_ENTRIES)
+			: ArcLengthTable(bSplinePath, ARC_LENGTH_ENTRIES);
+		GLdouble buildTime = std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - start).count();
+
+		GLuint framesPerSegment = stepCount(0.001f);
+		GLuint frames = table.segmentCount() * framesPerSegment;
+		GLfloat stride = table.length() / frames;
+		std::vector<glm::vec3> walked(frames), even(frames);
+
+		start = std::chrono::steady_clock::now();
+		for (GLuint r = 0; r < REPEATS; r++) {
+			for (GLuint f = 0; f < frames; f++)
+				walked[f] = position(f / framesPerSegment, (f % framesPerSegment) * 0.001f);
+		}
+		auto mid = std::chrono::steady_clock::now();
+		for (GLuint r = 0; r < REPEATS; r++) {
+			for (GLuint f = 0; f < frames; f++) {
+				GLuint s;
+				GLfloat t;
+				table.locate(f * stride, s, t);
+				even[f] = position(s, t);
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		GLfloat walkedMin = FLT_MAX, walkedMax = 0, evenMin = FLT_MAX, evenMax = 0;
+		for (GLuint f = 1; f < frames; f++) {
+			GLfloat w = glm::distance(walked[f], walked[f - 1]);
+			GLfloat e = glm::distance(even[f], even[f - 1]);
+			walkedMin = glm::min(walkedMin, w);
+			walkedMax = glm::max(walkedMax, w);
+			evenMin = glm::min(evenMin, e);
+			evenMax = glm::max(evenMax, e);
+		}
+
+		// distance of every located point from the start, integrated piece by piece
+		GLdouble maxError = 0;
+		for (GLuint f = 0; f < frames; f += 97) {
+			GLuint s;
+			GLfloat t;
+			table.locate(f * stride, s, t);
+			GLdouble d = 0;
+			for (GLuint k = 0; k < s; k++)
+				for (GLuint q = 0; q < 64; q++)
+					d += ArcLengthTable::measure(segments[k], q / 64.0f, (q + 1) / 64.0f);
+			for (GLuint q = 0; q < 64; q++)
+				d += ArcLengthTable::measure(segments[s], t * q / 64, t * (q + 1) / 64);
+			maxError = glm::max(maxError, glm::abs(d - (GLdouble)f * stride));
+		}
 
+		GLdouble samples = (GLdouble)REPEATS * frames;
+		std::cout << names[b] << "\t" << table.length() << "\t" << table.bytes() / 1024.0 << "\t\t" << buildTime * 1000.0
+			<< "\t\t" << walkedMin << " / " << walkedMax << "\t\t" << evenMin << " / " << evenMax
+			<< "\t\t" << std::chrono::duration<GLdouble>(mid - start).count() / samples * 1E9
+			<< "\t\t\t" << std::chrono::duration<GLdouble>(end - mid).count() / samples * 1E9
+			<< "\t\t\t" << maxError << "\n";
+	}
+}
+
+// for 8 frames move actors at random places and speeds along a random closed Catmull-Rom path of
+// points control points and sample position and tangent of every actor each frame, one at a time
+// and with one batch call over the actors kept in path order
+GLvoid benchmarkCrowd(GLuint actors, GLuint points) {
+	const GLuint FRAMES = 8;
+	points = glm::max(points, 3u);
+	srand(0);
+	std::vector<GLfloat> controls;
+	for (GLuint k = 0; k < points; k++) {
+		glm::vec2 p = glm::diskRand(1000.0f);
+		controls.insert(controls.end(), { p.x, 0, p.y });
+	}
+	auto start = std::chrono::steady_clock::now();
+	SplineCurve<CatmullRomBasis> path(controls.data(), points, SPLINE_CLOSED);
+	GLdouble buildTime = std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<GLfloat> u(actors), speed(actors);
+	for (GLuint a = 0; a < actors; a++) {
+		u[a] = glm::linearRand(0.0f, (GLfloat)path.segmentCount());
+		speed[a] = glm::linearRand(0.5f, 2.0f);
+	}
+	std::sort(u.begin(), u.end());
+	std::vector<GLfloat> single(actors * 6), batch(actors * 6);
+	GLdouble singleTime = 0, batchTime = 0, maxDiff = 0;
+	for (GLuint f = 0; f < FRAMES; f++) {
+		start = std::chrono::steady_clock::now();
+		for (GLuint a = 0; a < actors; a++) {
+			GLfloat t;
+			GLuint s = path.locate(u[a], t);
+			glm::vec3 p = path.position(s, t);
+			glm::vec3 v = path.tangent(s, t);
+			for (GLint c = 0; c < 3; c++) {
+				single[c * actors + a] = p[c];
+				single[(3 + c) * actors + a] = v[c];
+			}
+		}
+		auto mid = std::chrono::steady_clock::now();
+		GLfloat* values[3] = { &batch[0], &batch[actors], &batch[2 * actors] };
+		GLfloat* tangents[3] = { &batch[3 * actors], &batch[4 * actors], &batch[5 * actors] };
+		path.evaluate(u.data(), actors, values, tangents);
+		auto end = std::chrono::steady_clock::now();
+		singleTime += std::chrono::duration<GLdouble>(mid - start).count();
+		batchTime += std::chrono::duration<GLdouble>(end - mid).count();
+		for (size_t k = 0; k < single.size(); k++)
+			maxDiff = glm::max(maxDiff, (GLdouble)glm::abs(single[k] - batch[k]));
+
+		// advance and keep the actors in path order, nearly sorted input sorts in one pass
+		for (GLuint a = 0; a < actors; a++) {
+			u[a] += speed[a] * 0.01f;
+			if (u[a] >= path.segmentCount())
+				u[a] -= path.segmentCount();
+		}
+		for (GLuint a = 1; a < actors; a++) {
+			for (GLuint b = a; b > 0 && u[b - 1] > u[b]; b--) {
+				std::swap(u[b - 1], u[b]);
+				std::swap(speed[b - 1], speed[b]);
+			}
+		}
+	}
+	GLdouble samples = (GLdouble)FRAMES * actors;
+	std::cout << "actors\tpoints\tbuild ms\tsingle ns/actor\tbatch ns/actor\tspeedup\tmax difference\n";
+	std::cout << actors << "\t" << points << "\t" << buildTime * 1000.0 << "\t\t" << singleTime / samples * 1E9
+		<< "\t\t" << batchTime / samples * 1E9 << "\t\t" << singleTime / batchTime << "x\t" << maxDiff << "\n";
+}
+
+// simulate the render loop of the Catmull-Rom walk at dt = 0.001 for several frame rates, and at
+// 60 Hz drawing only every 4th frame as a batch render under load would; the old frame counter
+// advances one animation frame per draw, the clock follows the simulated time
+// reports when the walk ends and the torso position 10 s in, which only the clock keeps equal,
+// and the time spent sampling poses
+GLvoid benchmarkPlayback() {
+	const GLdouble rates[5] = { 30, 60, 144, 240, 60 };
+	const GLuint skips[5] = { 1, 1, 1, 1, 4 };
+	const GLdouble CHECK_TIME = 10;
+	GLfloat defaultDt = dt;
+	dt = 0.001f;
+	torsoAnim = torsoMotion<CatmullRomBasis>();
+	legAnim = legMotion();
+	GLfloat lastframe = (GLfloat)(torsoAnim.frameCount() - 1);
+	std::cout << "render Hz\tdrawn\tmode\twalk ends s\tposition at " << CHECK_TIME << " s\t\tsampling ms\n";
+	for (GLint r = 0; r < 5; r++) {
+		for (GLint mode = 0; mode < 2; mode++) {
+			PlaybackClock clock(60);
+			clock.start(0);
+			GLuint drawn = 0;
+			GLdouble endTime = 0, samplingTime = 0;
+			glm::vec3 checked(0);
+			GLboolean checkedSet = false;
+			for (GLuint tick = 0; endTime == 0; tick += skips[r]) {
+				GLdouble now = tick / rates[r];
+				GLfloat frame = mode == 0 ? (GLfloat)drawn : clock.frame(now);
+				frame = glm::min(frame, lastframe);
+				glm::mat4 torsoMat, legLMat, legRMat;
+				auto start = std::chrono::steady_clock::now();
+				walkPoses(frame, torsoMat, legLMat, legRMat);
+				samplingTime += std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - start).count();
+				drawn++;
+				if (!checkedSet && now >= CHECK_TIME) {
+					checked = glm::vec3(torsoMat[3]);
+					checkedSet = true;
+				}
+				if (frame >= lastframe)
+					endTime = now;
+			}
+			std::cout << rates[r] << (skips[r] > 1 ? " / 4" : "") << "\t\t" << drawn << "\t" << (mode == 0 ? "counter" : "clock")
+				<< "\t" << endTime << "\t\t" << checked.x << ", " << checked.z << "\t\t" << samplingTime * 1000.0 << "\n";
+		}
+	}
+	dt = defaultDt;
 }
 
 // linear interpolation
@@ -512,7 +892,7 @@ GLfloat lerp(GLfloat p0, GLfloat p1, GLfloat t) {
 }
 
 // define animation for legs wrt. torso
-GLvoid legMotion() {
+AnimationSampler legMotion() {
 
 	// control points for leg rotation
 	GLfloat legRotArray[9] = {
@@ -524,46 +904,28 @@ GLvoid legMotion() {
 	glm::vec3 posTransform = glm::vec3(0, 2.2, 0);
 	glm::mat2x3 controlPointsOri = glm::make_mat3x3(legRotArray);
 
-	GLfloat rolli, yawi, pitchi;
-
-	// forward swing
-	for (GLfloat i = 0; i < 1; i += (dt * 6)) {
-
-		// compute calmull-rom interpolation for orientation
-		rolli = lerp(controlPointsOri[0][0], controlPointsOri[1][0], i);
-		yawi = lerp(controlPointsOri[0][1], controlPointsOri[1][1], i);
-		pitchi = lerp(controlPointsOri[0][2], controlPointsOri[1][2], i);
-
-		// compute 4x4 transformation matrix 
-		glm::mat4 transformMatrix(1.0f); // identity matrix 
-		transformMatrix = glm::translate(transformMatrix, posTransform);
-		transformMatrix = glm::rotate(transformMatrix, glm::radians(yawi), glm::vec3(0, 1, 0));
-		transformMatrix = glm::rotate(transformMatrix, glm::radians(rolli), glm::vec3(1, 0, 0));
-		transformMatrix = glm::rotate(transformMatrix, glm::radians(pitchi), glm::vec3(0, 0, 1));
-
-		// push result into vector for return
-		legAnim.push_back(transformMatrix);
-	}
+	// forward swing from 0 to 1, then backward swing from 1 down to above 0
+	GLfloat step = dt * 6;
+	GLuint forwardFrames = stepCount(step);
+	GLuint backwardFrames = 0;
+	for (GLfloat i = 1; i > 0; i -= step)
+		backwardFrames++;
 
 	// record the mid-point for leg animation to offset right leg animation on left leg animation
-	legAnimOffset = legAnim.size();
+	legAnimOffset = forwardFrames;
 
-	// backward swing
-	for (GLfloat i = 1; i > 0; i -= (dt * 6)) {
+	return AnimationSampler(forwardFrames + backwardFrames, [=](GLuint frame) {
+		GLfloat i = frame < forwardFrames ? frame * step : 1 - (frame - forwardFrames) * step;
 
 		// compute calmull-rom interpolation for orientation
-		rolli = lerp(controlPointsOri[0][0], controlPointsOri[1][0], i);
-		yawi = lerp(controlPointsOri[0][1], controlPointsOri[1][1], i);
-		pitchi = lerp(controlPointsOri[0][2], controlPointsOri[1][2], i);
-
-		// compute 4x4 transformation matrix 
-		glm::mat4 transformMatrix(1.0f); // identity matrix 
-		transformMatrix = glm::translate(transformMatrix, posTransform);
-		transformMatrix = glm::rotate(transformMatrix, glm::radians(yawi), glm::vec3(0, 1, 0));
-		transformMatrix = glm::rotate(transformMatrix, glm::radians(rolli), glm::vec3(1, 0, 0));
-		transformMatrix = glm::rotate(transformMatrix, glm::radians(pitchi), glm::vec3(0, 0, 1));
-
-		// push result into vector for return
-		legAnim.push_back(transformMatrix);
-	}
-}
\ No newline at end of file
+		GLfloat rolli = lerp(controlPointsOri[0][0], controlPointsOri[1][0], i);
+		GLfloat yawi = lerp(controlPointsOri[0][1], controlPointsOri[1][1], i);
+		GLfloat pitchi = lerp(controlPointsOri[0][2], controlPointsOri[1][2], i);
+
+		// rotate about y, then x, then z
+		glm::quat rotation = glm::angleAxis(glm::radians(yawi), glm::vec3(0, 1, 0))
+			* glm::angleAxis(glm::radians(rolli), glm::vec3(1, 0, 0))
+			* glm::angleAxis(glm::radians(pitchi), glm::vec3(0, 0, 1));
+		return Pose(posTransform, rotation);
+	}, POSE_CACHE_SIZE);
+}
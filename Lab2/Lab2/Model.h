@@ -12,6 +12,7 @@
 
 #include "Mesh.h"
 #include "Shader.h"
+#include "MappedFile.h"
 
 #include <string>
 #include <fstream>
@@ -19,6 +20,9 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
 using namespace std;
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
@@ -47,8 +51,17 @@ public:
 
 private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // the baked mesh cache of a model is written next to it and used instead of ASSIMP
+    // until the model file changes
     void loadModel(string const& path)
     {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        string cachePath = path + ".mesh";
+        if (meshCacheIsFresh(cachePath, path) && loadMeshCache(cachePath))
+            return;
+
         // read file via ASSIMP
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
@@ -58,11 +71,176 @@ private:
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+
+        writeMeshCache(cachePath);
+    }
+
+    // baked mesh cache layout, all numbers are 32 bit:
+    // magic, version, sizeof(Vertex), mesh count, then per mesh
+    // vertex count, index count, texture count, (type length, type, path length, path) per texture,
+    // padding to 4 bytes, raw vertices, raw indices
+    static const unsigned int MESH_CACHE_MAGIC = 0x4853454D; // "MESH"
+    static const unsigned int MESH_CACHE_VERSION = 1;
+
+    // a cache older than its model file is stale
+    bool meshCacheIsFresh(string const& cachePath, string const& path)
+    {
+        struct stat cacheInfo, modelInfo;
+        if (stat(cachePath.c_str(), &cacheInfo) != 0)
+            return false;
+        // ship caches without their model files
+        if (stat(path.c_str(), &modelInfo) != 0)
+            return true;
+        return cacheInfo.st_mtime >= modelInfo.st_mtime;
+    }
+
+    // create the meshes straight from the mapped cache file
+    // returns false without creating any mesh if the cache is invalid
+    bool loadMeshCache(string const& cachePath)
+    {
+        struct CachedMesh {
+            const char* vertices;
+            unsigned int vertexCount;
+            const char* indices;
+            unsigned int indexCount;
+            vector<pair<string, string> > textures; // type, path
+        };
+
+        MappedFile file(cachePath);
+        if (!file.isOpen())
+            return false;
+        const char* p = file.data;
+        const char* end = file.data + file.size;
+
+        unsigned int header[4];
+        if (!readCache(p, end, header, sizeof(header)))
+            return false;
+        if (header[0] != MESH_CACHE_MAGIC || header[1] != MESH_CACHE_VERSION || header[2] != sizeof(Vertex))
+            return false;
+
+        // every mesh takes at least its three counts, so a larger mesh count means a corrupt cache
+        if (header[3] > (size_t)(end - p) / (3 * sizeof(unsigned int)))
+            return false;
+
+        // check the whole file before creating any GL objects
+        vector<CachedMesh> cached(header[3]);
+        for (unsigned int i = 0; i < cached.size(); i++)
+        {
+            unsigned int counts[3];
+            if (!readCache(p, end, counts, sizeof(counts)))
+                return false;
+            cached[i].vertexCount = counts[0];
+            cached[i].indexCount = counts[1];
+            for (unsigned int t = 0; t < counts[2]; t++)
+            {
+                string type, texturePath;
+                if (!readCacheString(p, end, type) || !readCacheString(p, end, texturePath))
+                    return false;
+                cached[i].textures.push_back(make_pair(type, texturePath));
+            }
+            p = file.data + ((p - file.data + 3) & ~(size_t)3);
+
+            // compare counts against the bytes left by division, so huge counts cannot overflow
+            if (p > end || counts[0] > (size_t)(end - p) / sizeof(Vertex))
+                return false;
+            size_t vertexBytes = (size_t)counts[0] * sizeof(Vertex);
+            if (counts[1] > (size_t)(end - p - vertexBytes) / sizeof(unsigned int))
+                return false;
+            size_t indexBytes = (size_t)counts[1] * sizeof(unsigned int);
+            cached[i].vertices = p;
+            cached[i].indices = p + vertexBytes;
+            p += vertexBytes + indexBytes;
+        }
+
+        for (unsigned int i = 0; i < cached.size(); i++)
+        {
+            vector<Texture> textures;
+            for (unsigned int t = 0; t < cached[i].textures.size(); t++)
+                textures.push_back(loadTexture(cached[i].textures[t].second, cached[i].textures[t].first));
+            meshes.push_back(Mesh((const Vertex*)cached[i].vertices, cached[i].vertexCount,
+                (const unsigned int*)cached[i].indices, cached[i].indexCount, textures));
+        }
+        return true;
+    }
+
+    // copy size bytes from the cache at p and advance p
+    static bool readCache(const char*& p, const char* end, void* out, size_t size)
+    {
+        if ((size_t)(end - p) < size)
+            return false;
+        memcpy(out, p, size);
+        p += size;
+        return true;
+    }
+
+    static bool readCacheString(const char*& p, const char* end, string& out)
+    {
+        unsigned int length;
+        if (!readCache(p, end, &length, sizeof(length)) || (size_t)(end - p) < length)
+            return false;
+        out.assign(p, length);
+        p += length;
+        return true;
+    }
+
+    // bake the meshes loaded by ASSIMP
+    void writeMeshCache(string const& cachePath)
+    {
+        ofstream out(cachePath.c_str(), ios::binary | ios::trunc);
+        if (!out)
+        {
+            cout << "Could not write mesh cache " << cachePath << endl;
+            return;
+        }
+        unsigned int header[4] = { MESH_CACHE_MAGIC, MESH_CACHE_VERSION, (unsigned int)sizeof(Vertex), (unsigned int)meshes.size() };
+        out.write((const char*)header, sizeof(header));
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const Mesh& mesh = meshes[i];
+            unsigned int counts[3] = { (unsigned int)mesh.vertices.size(), (unsigned int)mesh.indices.size(), (unsigned int)mesh.textures.size() };
+            out.write((const char*)counts, sizeof(counts));
+            for (unsigned int t = 0; t < mesh.textures.size(); t++)
+            {
+                writeCacheString(out, mesh.textures[t].type);
+                writeCacheString(out, mesh.textures[t].path);
+            }
+            const char padding[4] = { 0, 0, 0, 0 };
+            out.write(padding, (4 - out.tellp() % 4) % 4);
+            out.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            out.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        }
+        if (!out)
+        {
+            cout << "Could not write mesh cache " << cachePath << endl;
+            out.close();
+            remove(cachePath.c_str());
+        }
+    }
+
+    static void writeCacheString(ofstream& out, string const& value)
+    {
+        unsigned int length = (unsigned int)value.size();
+        out.write((const char*)&length, sizeof(length));
+        out.write(value.data(), length);
+    }
+
+    // loads a texture of the model unless it was loaded already
+    Texture loadTexture(string const& path, string const& typeName)
+    {
+        for (unsigned int j = 0; j < textures_loaded.size(); j++)
+        {
+            if (textures_loaded[j].path == path)
+                return textures_loaded[j];
+        }
+        Texture texture;
+        texture.id = TextureFromFile(path.c_str(), this->directory);
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);
+        return texture;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -0,0 +1,57 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+// rigid transformation: rotate, then translate
+struct Pose {
+	glm::vec3 translation;
+	glm::quat rotation;
+
+	Pose();
+	Pose(glm::vec3 translation, glm::quat rotation);
+
+	// the same transformation as a matrix, composed only when it is drawn
+	glm::mat4 matrix() const;
+};
+
+// the pose of every frame of an animation track
+// a pose takes 7 floats (28 bytes) against 16 floats for a 4x4 matrix; quantized, the
+// rotation is stored as the smallest three components of the quaternion in 16 bits each,
+// and a pose takes 20 bytes
+class PoseTrack {
+public:
+	PoseTrack();
+	PoseTrack(GLboolean quantized);
+
+	void push_back(const Pose& pose);
+	void reserve(size_t n);
+	void clear();
+
+	size_t size() const {
+		return quantized ? quantizedPoses.size() : poses.size();
+	}
+	GLboolean isQuantized() const {
+		return quantized;
+	}
+	// memory taken by the stored poses
+	size_t bytes() const;
+
+	Pose operator[](size_t frame) const;
+
+private:
+	struct QuantizedPose {
+		glm::vec3 translation;
+		// the largest component is left out and recomputed from the others, the
+		// low bits of the first two values hold its index
+		GLushort rotation[3];
+	};
+
+	GLboolean quantized;
+	std::vector<Pose> poses;
+	std::vector<QuantizedPose> quantizedPoses;
+
+	static QuantizedPose encode(const Pose& pose);
+	static Pose decode(const QuantizedPose& pose);
+};
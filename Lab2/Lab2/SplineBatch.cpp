@@ -0,0 +1,94 @@
+#include "SplineBatch.h"
+#ifdef __AVX__
+#include <immintrin.h>
+#else
+#include <xmmintrin.h>
+#endif
+
+
+const GLfloat SplineBatch::CATMULL_ROM[16] = {
+	-0.5,  1.5, -1.5,  0.5,
+	 1.0, -2.5,  2.0, -0.5,
+	-0.5,  0.0,  0.5,  0.0,
+	 0.0,  1.0,  0.0,  0.0
+};
+
+const GLfloat SplineBatch::B_SPLINE[16] = {
+	-1 / 6.0,  3 / 6.0, -3 / 6.0, 1 / 6.0,
+	 3 / 6.0, -6 / 6.0,  3 / 6.0,       0,
+	-3 / 6.0,        0,  3 / 6.0,       0,
+	 1 / 6.0,  4 / 6.0,  1 / 6.0,       0
+};
+
+// multiply the basis with the control points once, so evaluation is a cubic polynomial per component
+SplineBatch::SplineBatch(const GLfloat* basis, const GLfloat* points, GLuint components)
+	: components(components < MAX_COMPONENTS ? components : MAX_COMPONENTS)
+{
+	for (GLuint c = 0; c < this->components; c++) {
+		for (GLuint k = 0; k < 4; k++) {
+			coeff[c][k] = 0;
+			for (GLuint j = 0; j < 4; j++)
+				coeff[c][k] += basis[k * 4 + j] * points[j * components + c];
+		}
+	}
+}
+
+// Horner form: ((c3 t + c2) t + c1) t + c0, derivative (3 c3 t + 2 c2) t + c1
+GLvoid SplineBatch::evaluate(const GLfloat* t, GLuint count, GLfloat* const* values, GLfloat* const* tangents) const
+{
+	for (GLuint k = 0; k < components; k++) {
+		GLfloat c3 = coeff[k][0];
+		GLfloat c2 = coeff[k][1];
+		GLfloat c1 = coeff[k][2];
+		GLfloat c0 = coeff[k][3];
+		GLfloat* value = values[k];
+		GLfloat* tangent = tangents ? tangents[k] : NULL;
+		GLuint i = 0;
+
+#ifdef __AVX__
+		__m256 c3_8 = _mm256_set1_ps(c3);
+		__m256 c2_8 = _mm256_set1_ps(c2);
+		__m256 c1_8 = _mm256_set1_ps(c1);
+		__m256 c0_8 = _mm256_set1_ps(c0);
+		__m256 g2_8 = _mm256_set1_ps(3 * c3);
+		__m256 g1_8 = _mm256_set1_ps(2 * c2);
+		for (; i + 8 <= count; i += 8) {
+			__m256 t_8 = _mm256_loadu_ps(t + i);
+			__m256 v = _mm256_add_ps(_mm256_mul_ps(c3_8, t_8), c2_8);
+			v = _mm256_add_ps(_mm256_mul_ps(v, t_8), c1_8);
+			v = _mm256_add_ps(_mm256_mul_ps(v, t_8), c0_8);
+			_mm256_storeu_ps(value + i, v);
+			if (tangent) {
+				__m256 g = _mm256_add_ps(_mm256_mul_ps(g2_8, t_8), g1_8);
+				g = _mm256_add_ps(_mm256_mul_ps(g, t_8), c1_8);
+				_mm256_storeu_ps(tangent + i, g);
+			}
+		}
+#endif
+		__m128 c3_4 = _mm_set1_ps(c3);
+		__m128 c2_4 = _mm_set1_ps(c2);
+		__m128 c1_4 = _mm_set1_ps(c1);
+		__m128 c0_4 = _mm_set1_ps(c0);
+		__m128 g2_4 = _mm_set1_ps(3 * c3);
+		__m128 g1_4 = _mm_set1_ps(2 * c2);
+		for (; i + 4 <= count; i += 4) {
+			__m128 t_4 = _mm_loadu_ps(t + i);
+			__m128 v = _mm_add_ps(_mm_mul_ps(c3_4, t_4), c2_4);
+			v = _mm_add_ps(_mm_mul_ps(v, t_4), c1_4);
+			v = _mm_add_ps(_mm_mul_ps(v, t_4), c0_4);
+			_mm_storeu_ps(value + i, v);
+			if (tangent) {
+				__m128 g = _mm_add_ps(_mm_mul_ps(g2_4, t_4), g1_4);
+				g = _mm_add_ps(_mm_mul_ps(g, t_4), c1_4);
+				_mm_storeu_ps(tangent + i, g);
+			}
+		}
+
+		// remaining values
+		for (; i < count; i++) {
+			value[i] = ((c3 * t[i] + c2) * t[i] + c1) * t[i] + c0;
+			if (tangent)
+				tangent[i] = (3 * c3 * t[i] + 2 * c2) * t[i] + c1;
+		}
+	}
+}
@@ -11,9 +11,15 @@
 #include "Camera.h"
 #include "Model.h"
 #include "RigidBody.h"
+#include "SweepAndPrune.h"
 #include "MyMath.h"
+#include "JobSystem.h"
 
 #include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
 
@@ -41,40 +47,61 @@ GLfloat lastFrame = 0.0f;
 // frame index
 GLint frameCount = 0;
 
+// fixed time step of the headless mode
+const GLfloat FIXED_DT = 1.0f / 60.0f;
+
+// number of spheres created by init()
+GLuint sphereCount = 10;
+
 // object list
-std::vector<Sphere> sphereList;
-std::vector<glm::vec3> colorList;
+SphereStore sphereList;
+
+// broadphase for sphere-sphere collisions
+SweepAndPrune broadphase;
+
+// worker threads of the simulation
+JobSystem jobs;
 
 // lighting
 glm::vec3 lightPos(0.0f, 30.0f, 0.0f);
 
-GLvoid drawBox(GLuint VAO, Shader modelShader);
-GLvoid resolveCollision(Sphere& a, Sphere& b, glm::vec3 normal);
+GLvoid drawBox(GLuint VAO, const Shader& modelShader);
+GLvoid resolveCollision(GLuint a, GLuint b, glm::vec3 normal);
+GLvoid simulate(GLfloat dt);
+GLint runHeadless(GLint argc, char** argv);
+GLint runScaling(GLint argc, char** argv);
 
 //================================
 // init
 //================================
 GLvoid init(GLvoid) {
 	sphereList.clear();
+	sphereList.reserve(sphereCount);
 	const glm::vec3 ZERO_VEC = glm::vec3(0);
-	// create 10 random spheres
-	for (size_t i = 0; i < 10; i++) {
+	// create random spheres
+	for (size_t i = 0; i < sphereCount; i++) {
 		// generate random parameters
 		glm::vec3 random_position = glm::linearRand(glm::vec3(-10, 5, -10), glm::vec3(10, 25, 10));
 		glm::vec3 random_linearVelocity = glm::linearRand(glm::vec3(-10, -10, -10), glm::vec3(10, 10, 10));
 		GLfloat random_radius = glm::linearRand(2.0f, 3.0f);
 		GLfloat random_mass = glm::linearRand(20, 30);
-		// push back into list
-		sphereList.push_back(Sphere(random_position, random_linearVelocity, ZERO_VEC, ZERO_VEC, ZERO_VEC, random_mass, 0.8, 0, random_radius));
 		// random colors for each sphere
 		glm::vec3 random_color = glm::linearRand(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f));
-		colorList.push_back(random_color);
+		// push back into list
+		sphereList.add(Sphere(random_position, random_linearVelocity, ZERO_VEC, ZERO_VEC, ZERO_VEC, random_mass, 0.8, 0, random_radius), random_color);
 	}
 
 }
 
-GLint main()
+GLint main(GLint argc, char** argv)
 {
+	// run "Lab3 headless <spheres> <steps> <seed>" to simulate without a window
+	if (argc > 1 && strcmp(argv[1], "headless") == 0)
+		return runHeadless(argc, argv);
+	// run "Lab3 scaling <spheres> <steps> <threads>" to time the simulation with 1 ... threads threads
+	if (argc > 1 && strcmp(argv[1], "scaling") == 0)
+		return runScaling(argc, argv);
+
 	init();
 	// glfw: initialize and configure
 	// ------------------------------
@@ -166,6 +193,9 @@ GLint main()
 	// draw in wireframe
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+	// per-sphere transforms and colors, refilled every frame
+	std::vector<InstanceData> sphereInstances;
+
 	// render loop
 	// -----------
 	while (!glfwWindowShouldClose(window))
@@ -213,54 +243,25 @@ GLint main()
 		modelShader.setMat4("projection", projection);
 		modelShader.setMat4("view", view);
 
+		// update state of all spheres
+		simulate(deltaTime);
+
 		// draw spheres
+		sphereInstances.resize(sphereList.size());
 		for (int i = 0; i < sphereList.size(); i++) {
-			Sphere* s = &sphereList[i];
-
 			// draw according to Sphere properties
-			glm::vec3 posVec = s->position;
-			GLfloat radius = s->radius;
+			glm::vec3 posVec = sphereList.position[i];
+			GLfloat radius = sphereList.radius[i];
 			glm::mat4 model;
 			model = MyUtil::translate(glm::mat4(1.0), posVec);
 			model = MyUtil::scale(model, glm::vec3(radius));
-			modelShader.setMat4("model", model);
-			modelShader.setVec3("material.diffuse", colorList[i]);
-			sphere.Draw(modelShader);
-
-			// normal and depth for boundary collisions
-			glm::vec3 normal;
-			glm::vec3 depth;
-
-			// check for collision on boundaries
-			if (s->intersectBound(normal, depth)) {
-				// move out of overlap
-				s->move(-normal * depth);
-				// resolve collision
-				s->linearVelocity += - (1 + s->restitution) * glm::dot(s->linearVelocity, normal) * (normal) / glm::dot(normal, normal);
-			}
-			// update new state for sphere: move according to velocity and deltaTime
-			s->update(deltaTime);
+			sphereInstances[i].Model = model;
+			sphereInstances[i].Color = sphereList.color[i];
 		}
+		modelShader.setInt("instanced", 1);
+		sphere.DrawInstanced(modelShader, sphereInstances);
+		modelShader.setInt("instanced", 0);
 
-		// move spheres out of intersection
-		for (int i = 0; i < sphereList.size() - 1; i++) {
-			Sphere* a = &sphereList[i];
-			for (int j = i + 1; j < sphereList.size(); j++) {
-				Sphere* b = &sphereList[j];
-				glm::vec3 normal;
-				GLfloat depth;
-
-				// detect collision between spheres
-				if (Sphere::intersect(*a, *b, normal, depth)) {
-					// move out of ovelap
-					a->move(normal * depth * 0.5f);
-					b->move(-normal * depth * 0.5f);
-					// resolve collision
-					resolveCollision(*a, *b, normal);
-				}
-				
-			}
-		}
 		// draw physics simulation bounding box
 		drawBox(VAO, modelShader);
 
@@ -341,9 +342,10 @@ GLvoid scroll_callback(GLFWwindow* window, GLdouble xoffset, GLdouble yoffset)
 	camera.ProcessMouseScroll(static_cast<GLfloat>(yoffset));
 }
 
-GLvoid drawBox(GLuint VAO, Shader modelShader) {
+GLvoid drawBox(GLuint VAO, const Shader& modelShader) {
 	
 	glBindVertexArray(VAO);
+	GLint modelLoc = modelShader.location("model");
 	modelShader.setVec3("material.ambient", 1.0f, 1.0f, 1.0f);
 	modelShader.setVec3("material.diffuse", 1.0f, 1.0f, 1.0f);
 	modelShader.setVec3("material.specular", 0.0f, 0.0f, 0.0f);
@@ -351,28 +353,28 @@ GLvoid drawBox(GLuint VAO, Shader modelShader) {
 
 	// draw floor
 	glm::mat4 floorModel = glm::mat4(1.0);
-	modelShader.setMat4("model", floorModel);
+	modelShader.setMat4(modelLoc, floorModel);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
 	// draw wall
 	glm::mat4 wallModel;
 	wallModel = MyUtil::translate(floorModel, glm::vec3(-15, 15, 0));
 	wallModel = glm::rotate(wallModel, -glm::pi<GLfloat>() / 2.0f, glm::vec3(0, 0, 1));
-	modelShader.setMat4("model", wallModel);
+	modelShader.setMat4(modelLoc, wallModel);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
 	wallModel = MyUtil::translate(floorModel, glm::vec3(15, 15, 0));
 	wallModel = glm::rotate(wallModel, glm::pi<GLfloat>() / 2.0f, glm::vec3(0, 0, 1));
-	modelShader.setMat4("model", wallModel);
+	modelShader.setMat4(modelLoc, wallModel);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
 	wallModel = MyUtil::translate(floorModel, glm::vec3(0, 15, -15));
 	wallModel = glm::rotate(wallModel, glm::pi<GLfloat>() / 2.0f, glm::vec3(1, 0, 0));
-	modelShader.setMat4("model", wallModel);
+	modelShader.setMat4(modelLoc, wallModel);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 }
 
-GLvoid resolveCollision(Sphere& a, Sphere& b, glm::vec3 normal)
+GLvoid resolveCollision(GLuint a, GLuint b, glm::vec3 normal)
 {
 	// v1' = v1 + j * normal / mass1
 	// v2' = v2 - j * normal / mass2
@@ -380,11 +382,122 @@ GLvoid resolveCollision(Sphere& a, Sphere& b, glm::vec3 normal)
 	//		- (1 + restitution) * dot((v1 - v2), n)
 	// j = ------------------------------------------
 	//		 dot(n, n) * ((1 / mass1) + (1/ mass2))
-	GLfloat eps = glm::min(a.restitution, b.restitution);
-	glm::vec3 relativeVelocity = a.linearVelocity - b.linearVelocity;
+	GLfloat eps = glm::min(sphereList.restitution[a], sphereList.restitution[b]);
+	glm::vec3 relativeVelocity = sphereList.linearVelocity[a] - sphereList.linearVelocity[b];
 	GLfloat j = - (1 + eps) * glm::dot(relativeVelocity, normal);
-	j /= (1.0f / a.mass) + (1.0f / b.mass);
-	a.linearVelocity += j * normal / a.mass;
-	b.linearVelocity -= j * normal / b.mass;
+	j /= (1.0f / sphereList.mass[a]) + (1.0f / sphereList.mass[b]);
+	sphereList.linearVelocity[a] += j * normal / sphereList.mass[a];
+	sphereList.linearVelocity[b] -= j * normal / sphereList.mass[b];
 	
 }
+
+// advance the simulation by dt: boundary collisions, integration, then sphere-sphere collisions
+GLvoid simulate(GLfloat dt)
+{
+	// boundary collisions and integration only touch one sphere each, so they run on all threads
+	jobs.parallelFor(0, (GLuint)sphereList.size(), 1024, [&](GLuint begin, GLuint end) {
+		for (GLuint i = begin; i < end; i++) {
+			// normal and depth for boundary collisions
+			glm::vec3 normal;
+			glm::vec3 depth;
+
+			// check for collision on boundaries
+			if (sphereList.intersectBound(i, normal, depth)) {
+				// move out of overlap
+				sphereList.move(i, -normal * depth);
+				// resolve collision
+				glm::vec3& v = sphereList.linearVelocity[i];
+				v += - (1 + sphereList.restitution[i]) * glm::dot(v, normal) * (normal) / glm::dot(normal, normal);
+			}
+		}
+	});
+	// update new state for spheres: move according to velocity and dt
+	jobs.parallelFor(0, (GLuint)sphereList.size(), 1024, [&](GLuint begin, GLuint end) {
+		sphereList.update(dt, begin, end);
+	});
+
+	// move spheres out of intersection
+	// only pairs with overlapping bounding boxes are tested
+	broadphase.update(sphereList);
+	for (size_t k = 0; k < broadphase.pairs.size(); k++) {
+		GLuint a = broadphase.pairs[k].first;
+		GLuint b = broadphase.pairs[k].second;
+		glm::vec3 normal;
+		GLfloat depth;
+
+		// detect collision between spheres
+		if (sphereList.intersect(a, b, normal, depth)) {
+			// move out of ovelap
+			sphereList.move(a, normal * depth * 0.5f);
+			sphereList.move(b, -normal * depth * 0.5f);
+			// resolve collision
+			resolveCollision(a, b, normal);
+		}
+	}
+}
+
+// step the simulation at FIXED_DT without creating a window or GL context
+// usage: Lab3 headless [spheres] [steps] [seed]
+GLint runHeadless(GLint argc, char** argv)
+{
+	GLuint steps = 1000;
+	GLuint seed = 0;
+	if (argc > 2) sphereCount = (GLuint)strtoul(argv[2], NULL, 10);
+	if (argc > 3) steps = (GLuint)strtoul(argv[3], NULL, 10);
+	if (argc > 4) seed = (GLuint)strtoul(argv[4], NULL, 10);
+
+	// glm::linearRand draws from std::rand
+	srand(seed);
+	init();
+
+	auto start = std::chrono::steady_clock::now();
+	for (GLuint step = 0; step < steps; step++)
+		simulate(FIXED_DT);
+	std::chrono::duration<GLdouble> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << "spheres: " << sphereList.size()
+		<< "\tsteps: " << steps
+		<< "\tseconds: " << elapsed.count()
+		<< "\tsteps/s: " << steps / elapsed.count() << std::endl;
+	return 0;
+}
+
+// time the simulation with 1, 2, 4, ... threads up to all hardware threads
+// usage: Lab3 scaling [spheres] [steps] [threads]
+GLint runScaling(GLint argc, char** argv)
+{
+	GLuint steps = 200;
+	GLuint maxThreads = std::thread::hardware_concurrency();
+	sphereCount = 2000;
+	if (argc > 2) sphereCount = (GLuint)strtoul(argv[2], NULL, 10);
+	if (argc > 3) steps = (GLuint)strtoul(argv[3], NULL, 10);
+	if (argc > 4) maxThreads = (GLuint)strtoul(argv[4], NULL, 10);
+	if (maxThreads == 0) maxThreads = 1;
+
+	std::vector<GLuint> threadCounts;
+	for (GLuint t = 1; t < maxThreads; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(maxThreads);
+
+	GLdouble baseline = 0;
+	for (size_t k = 0; k < threadCounts.size(); k++) {
+		jobs.setThreadCount(threadCounts[k]);
+		// same start state for every thread count
+		srand(0);
+		init();
+
+		auto start = std::chrono::steady_clock::now();
+		for (GLuint step = 0; step < steps; step++)
+			simulate(FIXED_DT);
+		std::chrono::duration<GLdouble> elapsed = std::chrono::steady_clock::now() - start;
+
+		GLdouble rate = steps / elapsed.count();
+		if (k == 0) baseline = rate;
+		std::cout << "threads: " << threadCounts[k]
+			<< "\tsteps/s: " << rate
+			<< "\tspeedup: " << rate / baseline
+			<< "\tefficiency: " << rate / baseline / threadCounts[k] << std::endl;
+	}
+	jobs.setThreadCount(0);
+	return 0;
+}
@@ -21,29 +21,6 @@ RigidBody::RigidBody(
 	this->friction = friction;
 }
 
-void RigidBody::update(GLfloat dt)
-{
-	linearVelocity += force/mass * dt;
-	position += linearVelocity * dt;
-	rotation += rotationVelocity * dt;
-	force = glm::vec3(0, -9.8, 0) * mass;
-}
-
-void RigidBody::move(glm::vec3 amount)
-{
-	position += amount;
-}
-
-void RigidBody::setPosition(glm::vec3 position)
-{
-	this->position = position;
-}
-
-void RigidBody::applyForce(glm::vec3 force)
-{
-	this->force += force;
-}
-
 Sphere::Sphere(glm::vec3 position,
 	glm::vec3 linearVelocity,
 	glm::vec3 rotation,
@@ -62,26 +39,138 @@ Sphere::Sphere(glm::vec3 position,
 		restitution,
 		friction), radius(radius) {}
 
-bool Sphere::intersect(Sphere a, Sphere b, glm::vec3& normal, GLfloat& depth)
+// add a body and return its handle
+GLuint SphereStore::add(const Sphere& s, glm::vec3 color)
+{
+	GLuint i = (GLuint)size();
+	position.push_back(s.position);
+	linearVelocity.push_back(s.linearVelocity);
+	rotation.push_back(s.rotation);
+	rotationVelocity.push_back(s.rotationVelocity);
+	force.push_back(s.force);
+	mass.push_back(s.mass);
+	restitution.push_back(s.restitution);
+	friction.push_back(s.friction);
+	radius.push_back(s.radius);
+	this->color.push_back(color);
+
+	// reuse handles of removed bodies
+	GLuint h;
+	if (!freeHandles.empty()) {
+		h = freeHandles.back();
+		freeHandles.pop_back();
+		indexOf[h] = i;
+	}
+	else {
+		h = (GLuint)indexOf.size();
+		indexOf.push_back(i);
+	}
+	handleOf.push_back(h);
+	return h;
+}
+
+// remove a body by moving the last body into its place
+void SphereStore::remove(GLuint handle)
+{
+	GLuint i = indexOf[handle];
+	GLuint last = (GLuint)size() - 1;
+	position[i] = position[last];
+	linearVelocity[i] = linearVelocity[last];
+	rotation[i] = rotation[last];
+	rotationVelocity[i] = rotationVelocity[last];
+	force[i] = force[last];
+	mass[i] = mass[last];
+	restitution[i] = restitution[last];
+	friction[i] = friction[last];
+	radius[i] = radius[last];
+	color[i] = color[last];
+	handleOf[i] = handleOf[last];
+	indexOf[handleOf[i]] = i;
+
+	position.pop_back();
+	linearVelocity.pop_back();
+	rotation.pop_back();
+	rotationVelocity.pop_back();
+	force.pop_back();
+	mass.pop_back();
+	restitution.pop_back();
+	friction.pop_back();
+	radius.pop_back();
+	color.pop_back();
+	handleOf.pop_back();
+	freeHandles.push_back(handle);
+}
+
+void SphereStore::clear()
+{
+	position.clear();
+	linearVelocity.clear();
+	rotation.clear();
+	rotationVelocity.clear();
+	force.clear();
+	mass.clear();
+	restitution.clear();
+	friction.clear();
+	radius.clear();
+	color.clear();
+	indexOf.clear();
+	handleOf.clear();
+	freeHandles.clear();
+}
+
+void SphereStore::reserve(size_t n)
+{
+	position.reserve(n);
+	linearVelocity.reserve(n);
+	rotation.reserve(n);
+	rotationVelocity.reserve(n);
+	force.reserve(n);
+	mass.reserve(n);
+	restitution.reserve(n);
+	friction.reserve(n);
+	radius.reserve(n);
+	color.reserve(n);
+	handleOf.reserve(n);
+	indexOf.reserve(n);
+}
+
+// integrate all bodies with explicit Euler and reset their forces
+void SphereStore::update(GLfloat dt)
+{
+	update(dt, 0, (GLuint)size());
+}
+
+// update only bodies begin ... end - 1
+void SphereStore::update(GLfloat dt, GLuint begin, GLuint end)
+{
+	for (GLuint i = begin; i < end; i++) {
+		linearVelocity[i] += force[i] / mass[i] * dt;
+		position[i] += linearVelocity[i] * dt;
+		rotation[i] += rotationVelocity[i] * dt;
+		force[i] = glm::vec3(0, -9.8, 0) * mass[i];
+	}
+}
+
+bool SphereStore::intersect(GLuint a, GLuint b, glm::vec3& normal, GLfloat& depth) const
 {
 	normal = glm::vec3(0.0);
 	depth = 0.0f;
 
-	GLfloat distance = glm::distance(a.position, b.position);
-	GLfloat radii = a.radius + b.radius;
+	GLfloat distance = glm::distance(position[a], position[b]);
+	GLfloat radii = radius[a] + radius[b];
 
 	if (distance >= radii)
 	{
 		return false;
 	}
 
-	normal = glm::normalize(a.position - b.position);
+	normal = glm::normalize(position[a] - position[b]);
 	depth = radii - distance;
 
 	return true;
 }
 
-bool Sphere::intersectBound(glm::vec3& normal, glm::vec3& depth)
+bool SphereStore::intersectBound(GLuint i, glm::vec3& normal, glm::vec3& depth) const
 {
 	normal = glm::vec3(0.0);
 	depth = glm::vec3(0.0);
@@ -89,37 +178,37 @@ bool Sphere::intersectBound(glm::vec3& normal, glm::vec3& depth)
 	bool isHit = false;
 
 	GLfloat dist;
-	dist = position.x - (-15) - radius;
+	dist = position[i].x - (-15) - radius[i];
 	if (dist < 0) {
 		isHit = true;
 		normal.x += 1;
 		depth.x += dist; 
 	}
-	dist = 15 - position.x - radius;
+	dist = 15 - position[i].x - radius[i];
 	if (dist < 0) {
 		isHit = true;
 		normal.x -= 1;
 		depth.x += dist; 
 	}
-	dist = position.y - 0 - radius;
+	dist = position[i].y - 0 - radius[i];
 	if (dist < 0) {
 		isHit = true;
 		normal.y += 1;
 		depth.y += dist; 
 	}
-	dist = 30 - position.y - radius;
+	dist = 30 - position[i].y - radius[i];
 	if (dist < 0) {
 		isHit = true;
 		normal.y -= 1;
 		depth.y += dist;
 	}
-	dist = position.z - (-15) - radius;
+	dist = position[i].z - (-15) - radius[i];
 	if (dist < 0) {
 		isHit = true;
 		normal.z += 1;
 		depth.z += dist; 
 	}
-	dist = 15 - position.z - radius;
+	dist = 15 - position[i].z - radius[i];
 	if (dist < 0) {
 		isHit = true;
 		normal.z -= 1;
@@ -4,6 +4,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/constants.hpp>
+#include <vector>
 
 
 class RigidBody
@@ -27,12 +28,6 @@ public:
 		GLfloat mass,
 		GLfloat restitution,
 		GLfloat friction);
-
-	void update(GLfloat dt);
-	void move(glm::vec3 amount);
-	void setPosition(glm::vec3 position);
-	void applyForce(glm::vec3 force);
-	
 };
 
 class Sphere : public RigidBody {
@@ -47,6 +42,58 @@ public:
 		GLfloat restitution,
 		GLfloat friction,
 		GLfloat radius);
-	bool static intersect(Sphere a, Sphere b, glm::vec3& normal, GLfloat& depth);
-	bool intersectBound(glm::vec3& normal, glm::vec3& depth);
+};
+
+// structure-of-arrays storage of spheres: one contiguous array per field
+// bodies are addressed by index i in [0, size()), which changes when bodies are removed
+// handles returned by add() stay valid until the body is removed
+class SphereStore {
+public:
+	std::vector<glm::vec3> position;
+	std::vector<glm::vec3> linearVelocity;
+	std::vector<glm::vec3> rotation;
+	std::vector<glm::vec3> rotationVelocity;
+	std::vector<glm::vec3> force;
+	std::vector<GLfloat> mass;
+	std::vector<GLfloat> restitution;
+	std::vector<GLfloat> friction;
+	std::vector<GLfloat> radius;
+	std::vector<glm::vec3> color;
+
+	GLuint add(const Sphere& s, glm::vec3 color);
+	void remove(GLuint handle);
+	void clear();
+	void reserve(size_t n);
+
+	size_t size() const {
+		return position.size();
+	}
+	// current index of the body with this handle
+	GLuint index(GLuint handle) const {
+		return indexOf[handle];
+	}
+	// handle of the body at index i
+	GLuint handle(GLuint i) const {
+		return handleOf[i];
+	}
+
+	void move(GLuint i, const glm::vec3& amount) {
+		position[i] += amount;
+	}
+	void setPosition(GLuint i, const glm::vec3& position) {
+		this->position[i] = position;
+	}
+	void applyForce(GLuint i, const glm::vec3& force) {
+		this->force[i] += force;
+	}
+
+	void update(GLfloat dt);
+	void update(GLfloat dt, GLuint begin, GLuint end);
+	bool intersect(GLuint a, GLuint b, glm::vec3& normal, GLfloat& depth) const;
+	bool intersectBound(GLuint i, glm::vec3& normal, glm::vec3& depth) const;
+
+private:
+	std::vector<GLuint> indexOf;
+	std::vector<GLuint> handleOf;
+	std::vector<GLuint> freeHandles;
 };
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <vector>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -65,6 +67,7 @@ public:
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        cacheUniformLocations();
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -76,66 +79,146 @@ public:
     {
         glUseProgram(ID);
     }
+    // location of a uniform, resolved when the program was linked
+    // returns -1, which glUniform* ignores, for uniforms the program does not use
+    // ------------------------------------------------------------------------
+    int location(const std::string& name) const
+    {
+        std::unordered_map<std::string, int>::const_iterator it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(location(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(location(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(location(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(location(name), 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(location(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(location(name), 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(location(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(location(name), 1, &value[0]);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(location(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // uniform functions taking a location from location()
+    // use these for uniforms set once per object to skip the name lookup
+    // ------------------------------------------------------------------------
+    void setBool(int loc, bool value) const
+    {
+        glUniform1i(loc, (int)value);
+    }
+    void setInt(int loc, int value) const
+    {
+        glUniform1i(loc, value);
+    }
+    void setFloat(int loc, float value) const
+    {
+        glUniform1f(loc, value);
+    }
+    void setVec2(int loc, const glm::vec2& value) const
+    {
+        glUniform2fv(loc, 1, &value[0]);
+    }
+    void setVec3(int loc, const glm::vec3& value) const
+    {
+        glUniform3fv(loc, 1, &value[0]);
+    }
+    void setVec4(int loc, const glm::vec4& value) const
+    {
+        glUniform4fv(loc, 1, &value[0]);
+    }
+    void setMat2(int loc, const glm::mat2& mat) const
+    {
+        glUniformMatrix2fv(loc, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat3(int loc, const glm::mat3& mat) const
+    {
+        glUniformMatrix3fv(loc, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(int loc, const glm::mat4& mat) const
+    {
+        glUniformMatrix4fv(loc, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    std::unordered_map<std::string, int> uniformLocations;
+
+    // query the locations of all active uniforms of the linked program
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        GLint count = 0;
+        GLint maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength + 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size;
+            GLenum type;
+            GLsizei length;
+            glGetActiveUniform(ID, i, (GLsizei)buffer.size(), &length, &size, &type, &buffer[0]);
+            std::string name(&buffer[0], length);
+            uniformLocations[name] = glGetUniformLocation(ID, name.c_str());
+            // arrays are reported once as "name[0]": add the bare name and the other elements
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                uniformLocations[base] = uniformLocations[name];
+                for (GLint k = 1; k < size; k++)
+                {
+                    std::string element = base + "[" + std::to_string(k) + "]";
+                    uniformLocations[element] = glGetUniformLocation(ID, element.c_str());
+                }
+            }
+        }
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
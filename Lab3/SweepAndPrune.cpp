@@ -0,0 +1,75 @@
+#include "SweepAndPrune.h"
+#include <algorithm>
+
+
+// endpoint order along x
+// a min endpoint goes before a max endpoint of equal value so touching spheres are reported
+static bool precedes(const SweepAndPrune::EndPoint& a, const SweepAndPrune::EndPoint& b)
+{
+	return a.value < b.value || (a.value == b.value && a.isMin && !b.isMin);
+}
+
+// create endpoints for all spheres and sort them from scratch
+void SweepAndPrune::rebuild(const SphereStore& spheres)
+{
+	endPoints.clear();
+	for (size_t i = 0; i < spheres.size(); i++) {
+		endPoints.push_back({ spheres.position[i].x - spheres.radius[i], (GLuint)i, true });
+		endPoints.push_back({ spheres.position[i].x + spheres.radius[i], (GLuint)i, false });
+	}
+	std::sort(endPoints.begin(), endPoints.end(), precedes);
+	activeSlot.resize(spheres.size());
+}
+
+// refresh endpoint values, re-sort them and sweep along x to collect overlapping pairs
+void SweepAndPrune::update(const SphereStore& spheres)
+{
+	pairs.clear();
+	if (endPoints.size() != 2 * spheres.size())
+		rebuild(spheres);
+
+	// move endpoints to the current sphere extents
+	for (size_t k = 0; k < endPoints.size(); k++) {
+		GLuint i = endPoints[k].body;
+		endPoints[k].value = endPoints[k].isMin ? spheres.position[i].x - spheres.radius[i] : spheres.position[i].x + spheres.radius[i];
+	}
+
+	// insertion sort: endpoints only move a few places between frames
+	for (size_t k = 1; k < endPoints.size(); k++) {
+		EndPoint e = endPoints[k];
+		size_t m = k;
+		while (m > 0 && precedes(e, endPoints[m - 1])) {
+			endPoints[m] = endPoints[m - 1];
+			m--;
+		}
+		endPoints[m] = e;
+	}
+
+	// sweep: a sphere overlaps on x with every sphere active when its min endpoint is reached
+	active.clear();
+	for (size_t k = 0; k < endPoints.size(); k++) {
+		GLuint a = endPoints[k].body;
+		if (!endPoints[k].isMin) {
+			// remove from active list by swapping with the last one
+			GLuint slot = activeSlot[a];
+			active[slot] = active.back();
+			activeSlot[active[slot]] = slot;
+			active.pop_back();
+			continue;
+		}
+
+		glm::vec3 pa = spheres.position[a];
+		GLfloat ra = spheres.radius[a];
+		for (size_t m = 0; m < active.size(); m++) {
+			GLuint b = active[m];
+			glm::vec3 pb = spheres.position[b];
+			// prune pairs that do not overlap on y and z
+			GLfloat radii = ra + spheres.radius[b];
+			if (glm::abs(pa.y - pb.y) > radii) continue;
+			if (glm::abs(pa.z - pb.z) > radii) continue;
+			pairs.push_back(std::make_pair(glm::min(a, b), glm::max(a, b)));
+		}
+		activeSlot[a] = (GLuint)active.size();
+		active.push_back(a);
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <utility>
+#include "RigidBody.h"
+
+// broadphase for sphere collisions
+// keeps the x extents of all spheres as a sorted list of endpoints between frames
+// since spheres move little per frame, re-sorting with insertion sort is close to linear
+class SweepAndPrune {
+public:
+	// pairs of sphere indices whose bounding boxes overlap, filled by update()
+	std::vector<std::pair<GLuint, GLuint>> pairs;
+
+	struct EndPoint {
+		GLfloat value;
+		GLuint body;
+		GLboolean isMin;
+	};
+
+	void update(const SphereStore& spheres);
+
+private:
+	std::vector<EndPoint> endPoints;
+	// spheres whose x interval contains the sweep position
+	std::vector<GLuint> active;
+	// index of each sphere in active
+	std::vector<GLuint> activeSlot;
+
+	void rebuild(const SphereStore& spheres);
+};
@@ -2,19 +2,26 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per-instance attributes, only used when instanced is 1
+layout (location = 7) in mat4 aInstanceModel;
+layout (location = 11) in vec3 aInstanceColor;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+out vec3 InstanceColor;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform int instanced = 0;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    mat4 world = instanced == 1 ? aInstanceModel : model;
+    FragPos = vec3(world * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(world))) * aNormal;  
     TexCoords = aTexCoords;
+    InstanceColor = aInstanceColor;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
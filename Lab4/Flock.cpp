@@ -15,23 +15,21 @@ FlockAgent::FlockAgent(glm::vec3 position, glm::vec3 linearVelocity)
 // updates position based on linearVelocity
 // updates rotation
 // resets force
-// clear neighbors lists
-void FlockAgent::update(GLfloat dt)
+void FlockAgent::update(GLfloat dt, FlockAgent& next)
 {
 	//updates linearVelocity based on force
-	linearVelocity += force * dt;
+	next.linearVelocity = linearVelocity + force * dt;
 	// truncate velocity larger than 10 in magnitude
-	if (glm::dot(linearVelocity, linearVelocity) > 100.0f)
-		linearVelocity = 10.0f * glm::normalize(linearVelocity);
+	if (glm::dot(next.linearVelocity, next.linearVelocity) > 100.0f)
+		next.linearVelocity = 10.0f * glm::normalize(next.linearVelocity);
 	// updates position based on linearVelocity
-	position += linearVelocity * dt;
+	next.position = position + next.linearVelocity * dt;
 	// set rotation to the same orientation as velocity
-	rotation = MyUtil::findRotation(glm::vec3(0, 1, 0), glm::normalize(linearVelocity));
+	next.rotation = MyUtil::findRotation(glm::vec3(0, 1, 0), glm::normalize(next.linearVelocity));
+	next.rotationVelocity = rotationVelocity;
 	// reset force to 0
+	next.force = glm::vec3(0, 0, 0);
 	force = glm::vec3(0, 0, 0);
-	// clear neighbors lists
-	neighbors.clear();
-	closeNeighbors.clear();
 }
 
 void FlockAgent::move(glm::vec3 amount)
@@ -44,62 +42,58 @@ void FlockAgent::applyForce(glm::vec3 force)
 	this->force += force;
 }
 
-void FlockAgent::addNeighbor(FlockAgent* f)
-{
-	neighbors.push_back(f);
-}
-
-void FlockAgent::addCloseNeighbor(FlockAgent* f)
-{
-	closeNeighbors.push_back(f);
-}
-
 // add a force pointing towards the center of all neighbors
-void FlockAgent::doCohesion()
+void FlockAgent::doCohesion(const FlockAgent* agents, const GLuint* neighbors, GLuint count)
 {
 	GLfloat coeff = 10.0f; // weight of cohesion
-	if (neighbors.empty()) return;
+	if (count == 0) return;
 	glm::vec3 destination{};
 	// calculate average position of neighbors
-	for (size_t i = 0; i < neighbors.size(); i++) {
-		destination += neighbors[i]->position;
+	for (GLuint i = 0; i < count; i++) {
+		destination += agents[neighbors[i]].position;
 	}
-	destination /= neighbors.size();
+	destination /= count;
 	glm::vec3 force = glm::normalize(destination);
 	applyForce(force * coeff);
 }
 
 // add a force pointing towards the average velocity of all neighbors
-void FlockAgent::doAlignment()
+void FlockAgent::doAlignment(const FlockAgent* agents, const GLuint* neighbors, GLuint count)
 {
 	GLfloat coeff = 10.0f; // weight of alignment
-	if (neighbors.empty()) return;
+	if (count == 0) return;
 	glm::vec3 destination{};
 	// calculate average velocity of neighbors
-	for (size_t i = 0; i < neighbors.size(); i++) {
-		destination += neighbors[i]->linearVelocity;
+	for (GLuint i = 0; i < count; i++) {
+		destination += agents[neighbors[i]].linearVelocity;
 	}
-	destination /= neighbors.size();
+	destination /= count;
 	glm::vec3 force = glm::normalize(destination);
 	applyForce(force * coeff);
 }
 
 // add a force pointing away from the average position of nearby agents
 // cancel all force and add a force to move away from walls when near walls
-void FlockAgent::doAvoidance()
+void FlockAgent::doAvoidance(const FlockAgent* agents, const GLuint* closeNeighbors, GLuint count)
 {
 	GLfloat coeff = 10.0f; // weight of avoidance
-	if (!closeNeighbors.empty()) {
+	if (count > 0) {
 		glm::vec3 destination{};
-		for (size_t i = 0; i < closeNeighbors.size(); i++) {
+		for (GLuint i = 0; i < count; i++) {
 			// add all vectors pointing from neighbor to this agent
-			destination += position - closeNeighbors[i]->position;
+			destination += position - agents[closeNeighbors[i]].position;
 		}
-		destination /= closeNeighbors.size();
+		destination /= count;
 		glm::vec3 force = glm::normalize(destination);
 		applyForce(force * coeff);
 	}
-	// cancel all force and add a force to move away from walls when near walls
+	avoidWalls();
+}
+
+// cancel all force and add a force to move away from walls when near walls
+void FlockAgent::avoidWalls()
+{
+	GLfloat coeff = 10.0f; // weight of avoidance
 	if (position.x < -20) {
 		force = glm::vec3(0, 0, 0);
 		applyForce(glm::vec3(coeff, 0, 0));
@@ -140,31 +134,179 @@ Flock::Flock(GLfloat avoidanceRadius, GLfloat cohesionRadius, GLuint size) : avo
 		glm::vec3 random_linearVelocity = glm::linearRand(glm::vec3(-10, -10, -10), glm::vec3(10, 10, 10));
 		list.push_back(FlockAgent(random_position, random_linearVelocity));
 	}
-	findNeighbors();
+	buildGrid();
+}
+
+// cell of the uniform grid containing p
+glm::ivec3 Flock::cellCoord(const glm::vec3& p) const
+{
+	return glm::ivec3(glm::floor(p / cohesionRadius));
+}
+
+// map a grid cell to a bucket of the hash table
+GLuint Flock::hashCell(const glm::ivec3& c) const
+{
+	// xor-ing the products maps many nearby cells to the same value, so add them and mix the bits
+	GLuint h = (GLuint)c.x * 73856093u + (GLuint)c.y * 19349663u + (GLuint)c.z * 83492791u;
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h & (GLuint)(cellStart.size() - 2);
+}
+
+// sort agent indices by bucket with a counting sort
+void Flock::buildGrid()
+{
+	// table size is the next power of two >= twice the number of agents, so few cells share a bucket
+	size_t tableSize = 1;
+	while (tableSize < 2 * list.size())
+		tableSize <<= 1;
+	cellStart.assign(tableSize + 1, 0);
+	cellAgents.resize(list.size());
+	agentBucket.resize(list.size());
+	cellPositions.resize(list.size());
+	cellVelocities.resize(list.size());
+	cellCoords.resize(list.size());
+	// size the write buffer here, integrate runs on several threads and cannot resize it
+	if (next.size() != list.size())
+		next.assign(list.size(), FlockAgent(glm::vec3(0), glm::vec3(0)));
+
+	// count agents per bucket
+	for (size_t i = 0; i < list.size(); i++) {
+		agentBucket[i] = hashCell(cellCoord(list[i].position));
+		cellStart[agentBucket[i] + 1]++;
+	}
+	// prefix sum gives the start of each bucket
+	for (size_t h = 0; h < tableSize; h++)
+		cellStart[h + 1] += cellStart[h];
+	// scatter agent indices into their buckets
+	cursor.assign(cellStart.begin(), cellStart.end() - 1);
+	for (size_t i = 0; i < list.size(); i++) {
+		GLuint k = cursor[agentBucket[i]]++;
+		cellAgents[k] = (GLuint)i;
+		cellPositions[k] = list[i].position;
+		cellVelocities[k] = list[i].linearVelocity;
+		cellCoords[k] = cellCoord(list[i].position);
+	}
 }
 
 // find neighbors for all flockAgents in the list
-// push those in cohesion range to agent->neighbors
-// push those in avoidance range to agent->closeNeighbors
+// append those in cohesion range to the agent's row of neighbors
+// append those in avoidance range to the agent's row of closeNeighbors
+// only agents in the 27 grid cells around an agent are tested
 void Flock::findNeighbors()
 {
-	for (size_t i = 0; i < list.size() - 1; i++) {
-		FlockAgent* agentA = &list[i];
-		for (size_t j = i + 1; j < list.size(); j++) {
-			FlockAgent* agentB = &list[j];
-			GLfloat dist = MyUtil::distance(agentA->position, agentB->position);
-			if (dist < cohesionRadius) {
-				// push those in cohesion range to agent->neighbors
-				agentA->addNeighbor(agentB);
-				agentB->addNeighbor(agentA);
-
-				if (dist < avoidanceRadius) {
-					// push those in avoidance range to agent->closeNeighbors
-					agentA->addCloseNeighbor(agentB);
-					agentB->addCloseNeighbor(agentA);
+	neighborStart.assign(1, 0);
+	closeNeighborStart.assign(1, 0);
+	neighbors.clear();
+	closeNeighbors.clear();
+	if (list.empty()) return;
+	buildGrid();
+	agentRow.resize(list.size());
+
+	// visit agents in grid order so consecutive agents scan the same buckets
+	for (size_t n = 0; n < cellAgents.size(); n++) {
+		agentRow[cellAgents[n]] = (GLuint)n;
+		glm::vec3 posA = cellPositions[n];
+		glm::ivec3 cell = cellCoords[n];
+		for (GLint dx = -1; dx <= 1; dx++) {
+			for (GLint dy = -1; dy <= 1; dy++) {
+				for (GLint dz = -1; dz <= 1; dz++) {
+					glm::ivec3 c = cell + glm::ivec3(dx, dy, dz);
+					GLuint h = hashCell(c);
+					for (GLuint k = cellStart[h]; k < cellStart[h + 1]; k++) {
+						if (k == n) continue;
+						// skip agents of other cells sharing this bucket
+						if (cellCoords[k] != c) continue;
+
+						GLfloat dist = MyUtil::distance(posA, cellPositions[k]);
+						if (dist < cohesionRadius) {
+							neighbors.push_back(cellAgents[k]);
+							if (dist < avoidanceRadius)
+								closeNeighbors.push_back(cellAgents[k]);
+						}
+					}
+				}
+			}
+		}
+		neighborStart.push_back((GLuint)neighbors.size());
+		closeNeighborStart.push_back((GLuint)closeNeighbors.size());
+	}
+}
+
+void Flock::computeForces(GLuint begin, GLuint end)
+{
+	for (GLuint i = begin; i < end; i++) {
+		GLuint row = agentRow[i];
+		const GLuint* cohesion = neighbors.data() + neighborStart[row];
+		GLuint cohesionCount = neighborStart[row + 1] - neighborStart[row];
+		const GLuint* avoidance = closeNeighbors.data() + closeNeighborStart[row];
+		GLuint avoidanceCount = closeNeighborStart[row + 1] - closeNeighborStart[row];
+		list[i].doAlignment(list.data(), cohesion, cohesionCount);
+		list[i].doCohesion(list.data(), cohesion, cohesionCount);
+		list[i].doAvoidance(list.data(), avoidance, avoidanceCount);
+	}
+}
+
+// same forces as computeForces, but every candidate is read once from the grid arrays
+// and compared by squared distance
+void Flock::steer(GLuint begin, GLuint end)
+{
+	const GLfloat coeff = 10.0f; // weight of all behaviors
+	GLfloat cohesionSqr = cohesionRadius * cohesionRadius;
+	GLfloat avoidanceSqr = avoidanceRadius * avoidanceRadius;
+	for (GLuint n = begin; n < end; n++) {
+		glm::vec3 posA = cellPositions[n];
+		glm::ivec3 cell = cellCoords[n];
+		glm::vec3 positionSum(0), velocitySum(0), awaySum(0);
+		GLuint count = 0, closeCount = 0;
+		for (GLint dx = -1; dx <= 1; dx++) {
+			for (GLint dy = -1; dy <= 1; dy++) {
+				for (GLint dz = -1; dz <= 1; dz++) {
+					glm::ivec3 c = cell + glm::ivec3(dx, dy, dz);
+					GLuint h = hashCell(c);
+					for (GLuint k = cellStart[h]; k < cellStart[h + 1]; k++) {
+						if (k == n) continue;
+						// skip agents of other cells sharing this bucket
+						if (cellCoords[k] != c) continue;
+
+						glm::vec3 diff = posA - cellPositions[k];
+						GLfloat distSqr = glm::dot(diff, diff);
+						if (distSqr < cohesionSqr) {
+							positionSum += cellPositions[k];
+							velocitySum += cellVelocities[k];
+							count++;
+							if (distSqr < avoidanceSqr) {
+								awaySum += diff;
+								closeCount++;
+							}
+						}
+					}
 				}
 			}
+		}
 
+		// alignment, cohesion and avoidance as in doAlignment, doCohesion and doAvoidance
+		FlockAgent& agent = list[cellAgents[n]];
+		if (count > 0) {
+			agent.applyForce(glm::normalize(velocitySum / (GLfloat)count) * coeff);
+			agent.applyForce(glm::normalize(positionSum / (GLfloat)count) * coeff);
 		}
+		if (closeCount > 0)
+			agent.applyForce(glm::normalize(awaySum / (GLfloat)closeCount) * coeff);
+		agent.avoidWalls();
 	}
 }
+
+void Flock::integrate(GLfloat dt, GLuint begin, GLuint end)
+{
+	for (GLuint i = begin; i < end; i++)
+		list[i].update(dt, next[i]);
+}
+
+void Flock::swapBuffers()
+{
+	list.swap(next);
+}
@@ -15,26 +15,27 @@ public:
 	glm::quat rotation;
 	glm::vec3 rotationVelocity;
 	glm::vec3 force;
-	std::vector<FlockAgent*> neighbors;
-	std::vector<FlockAgent*> closeNeighbors;
 	
 	FlockAgent(
 		glm::vec3 position,
 		glm::vec3 linearVelocity
 	);
 
-	void update(GLfloat dt);
+	// write the state after dt into next, this agent is left unchanged except for its force
+	void update(GLfloat dt, FlockAgent& next);
 	void move(glm::vec3 amount);
 	void applyForce(glm::vec3 force);
 
-	void addNeighbor(FlockAgent* f);
-	void addCloseNeighbor(FlockAgent* f);
-
-	void doCohesion();
-	void doAlignment();
-	void doAvoidance();
+	// neighbors are agents[neighbors[0]] ... agents[neighbors[count - 1]]
+	void doCohesion(const FlockAgent* agents, const GLuint* neighbors, GLuint count);
+	void doAlignment(const FlockAgent* agents, const GLuint* neighbors, GLuint count);
+	void doAvoidance(const FlockAgent* agents, const GLuint* closeNeighbors, GLuint count);
+	void avoidWalls();
 };
 
+// agent state is double-buffered: forces are computed from list, which stays frozen during a step,
+// and the integrated agents are written to a second buffer that becomes list afterwards
+// both phases only write to their own agent, so they can be split across threads in any order
 class Flock {
 public:
 	std::vector<FlockAgent> list;
@@ -42,9 +43,55 @@ public:
 	GLfloat cohesionRadius;
 	Flock();
 	Flock(GLfloat avoidanceRadius, GLfloat cohesionRadius, GLuint size);
+	void buildGrid();
+
+	// neighbor lists and steering from them, kept only so "Lab4 bench" can compare them with steer
 	void findNeighbors();
+	// steer agents begin ... end - 1 using the neighbors found by findNeighbors
+	void computeForces(GLuint begin, GLuint end);
+	// steer the agents in grid slots begin ... end - 1 straight from the grid built by buildGrid,
+	// cohesion, alignment and avoidance are summed in one pass without storing neighbor lists
+	void steer(GLuint begin, GLuint end);
+	// integrate agents begin ... end - 1 into the write buffer
+	void integrate(GLfloat dt, GLuint begin, GLuint end);
+	// make the integrated agents the current ones
+	void swapBuffers();
 
 	size_t size() {
 		return list.size();
 	}
+	// number of neighbor pairs in cohesion range found by the last findNeighbors
+	size_t neighborCount() const {
+		return neighbors.size();
+	}
+
+private:
+	// write buffer of integrate
+	std::vector<FlockAgent> next;
+
+	// uniform grid with cell size of cohesionRadius, hashed into a table of cellStart.size() - 1 buckets
+	// agents of bucket h are cellAgents[cellStart[h]] ... cellAgents[cellStart[h + 1] - 1]
+	std::vector<GLuint> cellStart;
+	// next free slot of each bucket while agents are scattered
+	std::vector<GLuint> cursor;
+	std::vector<GLuint> cellAgents;
+	std::vector<GLuint> agentBucket;
+	// agent positions and velocities in cellAgents order so a bucket is scanned contiguously
+	std::vector<glm::vec3> cellPositions;
+	std::vector<glm::vec3> cellVelocities;
+	// grid cell of each slot, so bucket scans compare integers instead of recomputing cells
+	std::vector<glm::ivec3> cellCoords;
+
+	// neighbor lists in compressed sparse rows, one row per agent in grid order
+	// neighbors of agent i are neighbors[neighborStart[agentRow[i]]] ... neighbors[neighborStart[agentRow[i] + 1] - 1]
+	// closeNeighbors and closeNeighborStart hold those in avoidance range the same way
+	// the arrays keep their capacity, so after the first frames no memory is allocated
+	std::vector<GLuint> neighborStart;
+	std::vector<GLuint> neighbors;
+	std::vector<GLuint> closeNeighborStart;
+	std::vector<GLuint> closeNeighbors;
+	std::vector<GLuint> agentRow;
+
+	glm::ivec3 cellCoord(const glm::vec3& p) const;
+	GLuint hashCell(const glm::ivec3& c) const;
 };
@@ -11,8 +11,13 @@
 #include "Camera.h"
 #include "Model.h"
 #include "MyUtil.h"
+#include "JobSystem.h"
 
 #include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
 #include "Flock.h"
@@ -41,13 +46,27 @@ GLfloat lastFrame = 0.0f;
 // frame index
 GLint frameCount = 0;
 
+// fixed time step of the headless mode
+const GLfloat FIXED_DT = 1.0f / 60.0f;
+
+// number of agents created by init()
+GLuint flockSize = 100;
+
 // object list
 Flock flock;
 
+// worker threads of the simulation
+JobSystem jobs;
+
 // lighting
 glm::vec3 lightPos(0.0f, 80.0f, 70.0f);
 
-GLvoid drawBox(GLuint VAO, Shader modelShader, GLfloat width);
+GLvoid drawBox(GLuint VAO, const Shader& modelShader, GLfloat width);
+GLvoid benchmarkNeighbors();
+GLvoid benchmarkSteering();
+GLvoid simulate(GLfloat dt);
+GLint runHeadless(GLint argc, char** argv);
+GLint runScaling(GLint argc, char** argv);
 
 
 //================================
@@ -56,12 +75,24 @@ GLvoid drawBox(GLuint VAO, Shader modelShader, GLfloat width);
 GLvoid init(GLvoid) {
 	GLfloat cohesionRadius = 15;
 	GLfloat avoidanceRadius = 5;
-	GLfloat flockSize = 100;
 	flock = Flock(avoidanceRadius, cohesionRadius, flockSize);
 }
 
-GLint main()
+GLint main(GLint argc, char** argv)
 {
+	// run "Lab4 bench" to time the neighbor search and steering instead of opening a window
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		benchmarkNeighbors();
+		benchmarkSteering();
+		return 0;
+	}
+	// run "Lab4 headless <agents> <steps> <seed>" to simulate without a window
+	if (argc > 1 && strcmp(argv[1], "headless") == 0)
+		return runHeadless(argc, argv);
+	// run "Lab4 scaling <agents> <steps> <threads>" to time the simulation with 1 ... threads threads
+	if (argc > 1 && strcmp(argv[1], "scaling") == 0)
+		return runScaling(argc, argv);
+
 	init();
 	// glfw: initialize and configure
 	// ------------------------------
@@ -155,6 +186,9 @@ GLint main()
 	// draw in wireframe
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+	// per-agent transforms and colors, refilled every frame
+	std::vector<InstanceData> agentInstances;
+
 	// render loop
 	// -----------
 	while (!glfwWindowShouldClose(window))
@@ -202,27 +236,26 @@ GLint main()
 		modelShader.setMat4("projection", projection);
 		modelShader.setMat4("view", view);
 
-		// update neighbors for each agent
-		flock.findNeighbors();
+		// update state of all agents
+		simulate(deltaTime);
+
+		agentInstances.resize(flock.size());
 		for (int i = 0; i < flock.size(); i++) {
 			FlockAgent* agent = &flock.list[i];
 
-			// resolve all behaviors and update state of agent
-			agent->doAlignment();
-			agent->doCohesion();
-			agent->doAvoidance();
-			agent->update(deltaTime);
-
 			// set model matrix
 			glm::mat4 model;
 			model = MyUtil::translate(glm::mat4(1.0f), agent->position);
 			model = model * MyUtil::quat2mat4(agent->rotation);
-			modelShader.setMat4("model", model);
-			
-			// draw
-			cone.Draw(modelShader);
+			agentInstances[i].Model = model;
+			agentInstances[i].Color = glm::vec3(0.7f, 0.3f, 0.1f);
 		}
 
+		// draw all agents at once
+		modelShader.setInt("instanced", 1);
+		cone.DrawInstanced(modelShader, agentInstances);
+		modelShader.setInt("instanced", 0);
+
 		// draw physics simulation bounding box
 		drawBox(VAO, modelShader, width);
 
@@ -303,9 +336,10 @@ GLvoid scroll_callback(GLFWwindow* window, GLdouble xoffset, GLdouble yoffset)
 	camera.ProcessMouseScroll(static_cast<GLfloat>(yoffset));
 }
 
-GLvoid drawBox(GLuint VAO, Shader modelShader, GLfloat width) {
+GLvoid drawBox(GLuint VAO, const Shader& modelShader, GLfloat width) {
 	
 	glBindVertexArray(VAO);
+	GLint modelLoc = modelShader.location("model");
 	modelShader.setVec3("material.ambient", 1.0f, 1.0f, 1.0f);
 	modelShader.setVec3("material.diffuse", 1.0f, 1.0f, 1.0f);
 	modelShader.setVec3("material.specular", 0.0f, 0.0f, 0.0f);
@@ -313,24 +347,191 @@ GLvoid drawBox(GLuint VAO, Shader modelShader, GLfloat width) {
 
 	// draw floor
 	glm::mat4 floorModel = glm::mat4(1.0);
-	modelShader.setMat4("model", floorModel);
+	modelShader.setMat4(modelLoc, floorModel);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
 	// draw wall
 	glm::mat4 wallModel;
 	wallModel = MyUtil::translate(floorModel, glm::vec3(-width, width, 0));
 	wallModel = glm::rotate(wallModel, -glm::pi<GLfloat>() / 2.0f, glm::vec3(0, 0, 1));
-	modelShader.setMat4("model", wallModel);
+	modelShader.setMat4(modelLoc, wallModel);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
 	wallModel = MyUtil::translate(floorModel, glm::vec3(width, width, 0));
 	wallModel = glm::rotate(wallModel, glm::pi<GLfloat>() / 2.0f, glm::vec3(0, 0, 1));
-	modelShader.setMat4("model", wallModel);
+	modelShader.setMat4(modelLoc, wallModel);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
 	wallModel = MyUtil::translate(floorModel, glm::vec3(0, width, -width));
 	wallModel = glm::rotate(wallModel, glm::pi<GLfloat>() / 2.0f, glm::vec3(1, 0, 0));
-	modelShader.setMat4("model", wallModel);
+	modelShader.setMat4(modelLoc, wallModel);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 }
 
+
+// advance the flock by dt
+GLvoid simulate(GLfloat dt)
+{
+	// sort agents into the grid, then resolve all behaviors on the frozen agents in one pass
+	flock.buildGrid();
+	jobs.parallelFor(0, (GLuint)flock.size(), 256, [&](GLuint begin, GLuint end) {
+		flock.steer(begin, end);
+	});
+	// update state of agents into the other buffer
+	jobs.parallelFor(0, (GLuint)flock.size(), 256, [&](GLuint begin, GLuint end) {
+		flock.integrate(dt, begin, end);
+	});
+	flock.swapBuffers();
+}
+
+// step the flock at FIXED_DT without creating a window or GL context
+// usage: Lab4 headless [agents] [steps] [seed]
+GLint runHeadless(GLint argc, char** argv)
+{
+	GLuint steps = 1000;
+	GLuint seed = 0;
+	if (argc > 2) flockSize = (GLuint)strtoul(argv[2], NULL, 10);
+	if (argc > 3) steps = (GLuint)strtoul(argv[3], NULL, 10);
+	if (argc > 4) seed = (GLuint)strtoul(argv[4], NULL, 10);
+
+	// glm::linearRand draws from std::rand
+	srand(seed);
+	init();
+
+	auto start = std::chrono::steady_clock::now();
+	for (GLuint step = 0; step < steps; step++)
+		simulate(FIXED_DT);
+	std::chrono::duration<GLdouble> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << "agents: " << flock.size()
+		<< "\tsteps: " << steps
+		<< "\tseconds: " << elapsed.count()
+		<< "\tsteps/s: " << steps / elapsed.count() << std::endl;
+	return 0;
+}
+
+// time the simulation with 1, 2, 4, ... threads up to all hardware threads
+// usage: Lab4 scaling [agents] [steps] [threads]
+GLint runScaling(GLint argc, char** argv)
+{
+	GLuint steps = 20;
+	GLuint maxThreads = std::thread::hardware_concurrency();
+	flockSize = 2000;
+	if (argc > 2) flockSize = (GLuint)strtoul(argv[2], NULL, 10);
+	if (argc > 3) steps = (GLuint)strtoul(argv[3], NULL, 10);
+	if (argc > 4) maxThreads = (GLuint)strtoul(argv[4], NULL, 10);
+	if (maxThreads == 0) maxThreads = 1;
+
+	std::vector<GLuint> threadCounts;
+	for (GLuint t = 1; t < maxThreads; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(maxThreads);
+
+	GLdouble baseline = 0;
+	for (size_t k = 0; k < threadCounts.size(); k++) {
+		jobs.setThreadCount(threadCounts[k]);
+		// same start state for every thread count
+		srand(0);
+		init();
+
+		auto start = std::chrono::steady_clock::now();
+		for (GLuint step = 0; step < steps; step++)
+			simulate(FIXED_DT);
+		std::chrono::duration<GLdouble> elapsed = std::chrono::steady_clock::now() - start;
+
+		GLdouble rate = steps / elapsed.count();
+		if (k == 0) baseline = rate;
+		std::cout << "threads: " << threadCounts[k]
+			<< "\tsteps/s: " << rate
+			<< "\tspeedup: " << rate / baseline
+			<< "\tefficiency: " << rate / baseline / threadCounts[k] << std::endl;
+	}
+	jobs.setThreadCount(0);
+	return 0;
+}
+
+// time Flock::findNeighbors for 100 to 1M agents spawned at constant density
+// time per agent should stay flat if the search scales linearly
+GLvoid benchmarkNeighbors() {
+	GLfloat cohesionRadius = 15;
+	GLfloat avoidanceRadius = 5;
+	// volume per agent so that an agent has about 10 agents in cohesion range
+	GLfloat volumePerAgent = 4.0f / 3.0f * glm::pi<GLfloat>() * glm::pow(cohesionRadius, 3.0f) / 10.0f;
+
+	for (GLuint n = 100; n <= 1000000; n *= 10) {
+		Flock bench;
+		bench.cohesionRadius = cohesionRadius;
+		bench.avoidanceRadius = avoidanceRadius;
+		GLfloat halfWidth = 0.5f * glm::pow(volumePerAgent * n, 1.0f / 3.0f);
+		for (GLuint i = 0; i < n; i++) {
+			glm::vec3 random_position = glm::linearRand(glm::vec3(-halfWidth), glm::vec3(halfWidth));
+			glm::vec3 random_linearVelocity = glm::linearRand(glm::vec3(-10, -10, -10), glm::vec3(10, 10, 10));
+			bench.list.push_back(FlockAgent(random_position, random_linearVelocity));
+		}
+
+		GLint runs = 5;
+		size_t neighborCount = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (GLint r = 0; r < runs; r++) {
+			bench.findNeighbors();
+			neighborCount = bench.neighborCount();
+		}
+		std::chrono::duration<GLdouble> elapsed = std::chrono::steady_clock::now() - start;
+		GLdouble msPerStep = elapsed.count() * 1000.0 / runs;
+		std::cout << "agents: " << n
+			<< "\tavg neighbors: " << (GLdouble)neighborCount / n
+			<< "\tms/step: " << msPerStep
+			<< "\tns/agent: " << msPerStep * 1.0E6 / n << std::endl;
+	}
+}
+
+// time steering with stored neighbor lists (findNeighbors + computeForces)
+// against the fused single pass (buildGrid + steer) on one thread
+GLvoid benchmarkSteering() {
+	GLfloat cohesionRadius = 15;
+	GLfloat avoidanceRadius = 5;
+	GLfloat volumePerAgent = 4.0f / 3.0f * glm::pi<GLfloat>() * glm::pow(cohesionRadius, 3.0f) / 10.0f;
+
+	for (GLuint n = 1000; n <= 1000000; n *= 10) {
+		Flock bench;
+		bench.cohesionRadius = cohesionRadius;
+		bench.avoidanceRadius = avoidanceRadius;
+		GLfloat halfWidth = 0.5f * glm::pow(volumePerAgent * n, 1.0f / 3.0f);
+		for (GLuint i = 0; i < n; i++) {
+			glm::vec3 random_position = glm::linearRand(glm::vec3(-halfWidth), glm::vec3(halfWidth));
+			glm::vec3 random_linearVelocity = glm::linearRand(glm::vec3(-10, -10, -10), glm::vec3(10, 10, 10));
+			bench.list.push_back(FlockAgent(random_position, random_linearVelocity));
+		}
+
+		GLint runs = 5;
+		auto start = std::chrono::steady_clock::now();
+		for (GLint r = 0; r < runs; r++) {
+			bench.findNeighbors();
+			bench.computeForces(0, n);
+		}
+		std::chrono::duration<GLdouble> staged = std::chrono::steady_clock::now() - start;
+		std::vector<glm::vec3> stagedForce(n);
+		for (GLuint i = 0; i < n; i++) {
+			stagedForce[i] = bench.list[i].force;
+			bench.list[i].force = glm::vec3(0);
+		}
+
+		start = std::chrono::steady_clock::now();
+		for (GLint r = 0; r < runs; r++) {
+			bench.buildGrid();
+			bench.steer(0, n);
+		}
+		std::chrono::duration<GLdouble> fused = std::chrono::steady_clock::now() - start;
+
+		// both paths added their forces runs times, so the sums are comparable
+		GLfloat maxError = 0;
+		for (GLuint i = 0; i < n; i++)
+			maxError = glm::max(maxError, glm::length(stagedForce[i] - bench.list[i].force));
+
+		std::cout << "agents: " << n
+			<< "\tstaged ms/step: " << staged.count() * 1000.0 / runs
+			<< "\tfused ms/step: " << fused.count() * 1000.0 / runs
+			<< "\tspeedup: " << staged.count() / fused.count()
+			<< "\tmax force difference: " << maxError << std::endl;
+	}
+}
@@ -19,9 +19,12 @@ struct Light {
 in vec3 FragPos;  
 in vec3 Normal;  
 in vec2 TexCoords;
+in vec3 InstanceColor;
   
 uniform vec3 viewPos;
 uniform Material material;
+// instances take their diffuse color from InstanceColor instead of material
+uniform int instanced = 0;
 uniform Light light;
 uniform sampler2D texture_diffuse1;
 
@@ -34,7 +37,8 @@ void main()
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(light.position - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * (diff * material.diffuse);
+    vec3 diffuseColor = instanced == 1 ? InstanceColor : material.diffuse;
+    vec3 diffuse = light.diffuse * (diff * diffuseColor);
     
     // specular
     vec3 viewDir = normalize(viewPos - FragPos);
@@ -0,0 +1,101 @@
+#include "BlockTimestep.h"
+
+
+BlockTimestep::BlockTimestep() : maxLevel(6), accuracy(0.01f), forceEvaluations(0)
+{
+}
+
+BlockTimestep::BlockTimestep(GLuint maxLevel, GLfloat accuracy) : maxLevel(maxLevel), accuracy(accuracy), forceEvaluations(0)
+{
+}
+
+void BlockTimestep::reset()
+{
+	level.clear();
+	acceleration.clear();
+}
+
+std::vector<GLuint> BlockTimestep::levelCounts() const
+{
+	std::vector<GLuint> counts(maxLevel + 1, 0);
+	for (size_t i = 0; i < level.size(); i++)
+		counts[level[i]]++;
+	return counts;
+}
+
+// coarsest level whose step dt / 2^level satisfies the accuracy criterion
+GLuint BlockTimestep::levelFor(const RealVec3& a, Real dt) const
+{
+	Real aSqr = glm::dot(a, a);
+	if (aSqr == 0) return 0;
+	Real wanted = glm::sqrt(2 * accuracy / glm::sqrt(aSqr));
+	GLuint l = 0;
+	while (l < maxLevel && dt / (Real)(1u << l) > wanted)
+		l++;
+	return l;
+}
+
+// forces and accelerations of the bodies in active
+void BlockTimestep::evaluate(SphereStore& bodies, const ForceFunction& computeForces)
+{
+	for (size_t k = 0; k < active.size(); k++)
+		bodies.force[active[k]] = RealVec3(0);
+	computeForces(active);
+	for (size_t k = 0; k < active.size(); k++) {
+		GLuint i = active[k];
+		acceleration[i] = bodies.force[i] / bodies.mass[i];
+		bodies.force[i] = RealVec3(0);
+	}
+	forceEvaluations += active.size();
+}
+
+void BlockTimestep::step(SphereStore& bodies, GLfloat dt, const ForceFunction& computeForces)
+{
+	GLuint n = (GLuint)bodies.size();
+	if (n == 0) return;
+
+	// first step or bodies changed: all bodies need their acceleration and level
+	if (level.size() != n) {
+		level.assign(n, 0);
+		acceleration.assign(n, RealVec3(0));
+		active.resize(n);
+		for (GLuint i = 0; i < n; i++)
+			active[i] = i;
+		evaluate(bodies, computeForces);
+		for (GLuint i = 0; i < n; i++)
+			level[i] = levelFor(acceleration[i], dt);
+	}
+
+	GLuint ticks = 1u << maxLevel;
+	Real tick = (Real)dt / ticks;
+	for (GLuint t = 0; t < ticks; t++) {
+		// opening half kick of the bodies starting a step at this tick
+		for (GLuint i = 0; i < n; i++) {
+			GLuint ticksPerStep = 1u << (maxLevel - level[i]);
+			if (t % ticksPerStep == 0)
+				bodies.linearVelocity[i] += acceleration[i] * (Real(0.5) * tick * ticksPerStep);
+		}
+		for (GLuint i = 0; i < n; i++)
+			bodies.position[i] += bodies.linearVelocity[i] * tick;
+
+		// closing half kick of the bodies whose step ends after this tick
+		active.clear();
+		for (GLuint i = 0; i < n; i++) {
+			if ((t + 1) % (1u << (maxLevel - level[i])) == 0)
+				active.push_back(i);
+		}
+		evaluate(bodies, computeForces);
+		for (size_t k = 0; k < active.size(); k++) {
+			GLuint i = active[k];
+			bodies.linearVelocity[i] += acceleration[i] * (Real(0.5) * tick * (1u << (maxLevel - level[i])));
+			// a body may move to a coarser level only where the coarser steps begin
+			GLuint l = levelFor(acceleration[i], dt);
+			while (l < level[i] && (t + 1) % (1u << (maxLevel - l)) != 0)
+				l++;
+			level[i] = l;
+		}
+	}
+
+	for (GLuint i = 0; i < n; i++)
+		bodies.rotation[i] += bodies.rotationVelocity[i] * dt;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <functional>
+#include <vector>
+#include "RigidBody.h"
+
+// kick-drift-kick leapfrog with power-of-two block time steps
+// body i advances with steps of dt / 2^level[i], where level is the coarsest one
+// whose step is at most sqrt(2 * accuracy / |acceleration|), i.e. the acceleration may
+// move the body by about accuracy per step
+// a step of dt is split into 2^maxLevel ticks; all bodies drift every tick, but forces
+// are only computed for the bodies whose step ends at that tick
+class BlockTimestep {
+public:
+	GLuint maxLevel;
+	GLfloat accuracy;
+	// number of single-body force evaluations so far
+	size_t forceEvaluations;
+
+	BlockTimestep();
+	BlockTimestep(GLuint maxLevel, GLfloat accuracy);
+
+	// computeForces must add to bodies.force[i] the force at the current positions for every i in active
+	typedef std::function<void(const std::vector<GLuint>& active)> ForceFunction;
+
+	// advance all bodies by dt, they are synchronized again at the end
+	void step(SphereStore& bodies, GLfloat dt, const ForceFunction& computeForces);
+	// forget levels and accelerations, e.g. after bodies were added or removed
+	void reset();
+
+	// number of bodies on each level after the last step
+	std::vector<GLuint> levelCounts() const;
+
+private:
+	std::vector<GLuint> level;
+	std::vector<RealVec3> acceleration;
+	std::vector<GLuint> active;
+
+	GLuint levelFor(const RealVec3& a, Real dt) const;
+	void evaluate(SphereStore& bodies, const ForceFunction& computeForces);
+};
@@ -0,0 +1,199 @@
+#include "GravityKernel.h"
+#ifdef __AVX__
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+// the widest vector of Real available, all loops below are written once in these operations
+#if defined(LAB5_DOUBLE_PRECISION) && defined(__AVX__)
+typedef __m256d vreal;
+static const GLuint WIDTH = 4;
+static inline vreal vset(Real a) { return _mm256_set1_pd(a); }
+static inline vreal vload(const Real* p) { return _mm256_loadu_pd(p); }
+static inline void vstore(Real* p, vreal a) { _mm256_storeu_pd(p, a); }
+static inline vreal vadd(vreal a, vreal b) { return _mm256_add_pd(a, b); }
+static inline vreal vsub(vreal a, vreal b) { return _mm256_sub_pd(a, b); }
+static inline vreal vmul(vreal a, vreal b) { return _mm256_mul_pd(a, b); }
+static inline vreal vrsqrt(vreal a) { return _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_sqrt_pd(a)); }
+static inline vreal vand(vreal a, vreal b) { return _mm256_and_pd(a, b); }
+static inline vreal vgreater(vreal a, vreal b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+static inline vreal vlanes() { return _mm256_setr_pd(0, 1, 2, 3); }
+static inline Real vsum(vreal a)
+{
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+	s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+	return _mm_cvtsd_f64(s);
+}
+#elif defined(LAB5_DOUBLE_PRECISION)
+typedef __m128d vreal;
+static const GLuint WIDTH = 2;
+static inline vreal vset(Real a) { return _mm_set1_pd(a); }
+static inline vreal vload(const Real* p) { return _mm_loadu_pd(p); }
+static inline void vstore(Real* p, vreal a) { _mm_storeu_pd(p, a); }
+static inline vreal vadd(vreal a, vreal b) { return _mm_add_pd(a, b); }
+static inline vreal vsub(vreal a, vreal b) { return _mm_sub_pd(a, b); }
+static inline vreal vmul(vreal a, vreal b) { return _mm_mul_pd(a, b); }
+static inline vreal vrsqrt(vreal a) { return _mm_div_pd(_mm_set1_pd(1.0), _mm_sqrt_pd(a)); }
+static inline vreal vand(vreal a, vreal b) { return _mm_and_pd(a, b); }
+static inline vreal vgreater(vreal a, vreal b) { return _mm_cmpgt_pd(a, b); }
+static inline vreal vlanes() { return _mm_setr_pd(0, 1); }
+static inline Real vsum(vreal a)
+{
+	return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a)));
+}
+#elif defined(__AVX__)
+typedef __m256 vreal;
+static const GLuint WIDTH = 8;
+static inline vreal vset(GLfloat a) { return _mm256_set1_ps(a); }
+static inline vreal vload(const GLfloat* p) { return _mm256_loadu_ps(p); }
+static inline void vstore(GLfloat* p, vreal a) { _mm256_storeu_ps(p, a); }
+static inline vreal vadd(vreal a, vreal b) { return _mm256_add_ps(a, b); }
+static inline vreal vsub(vreal a, vreal b) { return _mm256_sub_ps(a, b); }
+static inline vreal vmul(vreal a, vreal b) { return _mm256_mul_ps(a, b); }
+static inline vreal vrsqrt(vreal a) { return _mm256_rsqrt_ps(a); }
+static inline vreal vand(vreal a, vreal b) { return _mm256_and_ps(a, b); }
+static inline vreal vgreater(vreal a, vreal b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+static inline vreal vlanes() { return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); }
+static inline GLfloat vsum(vreal a)
+{
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+#else
+typedef __m128 vreal;
+static const GLuint WIDTH = 4;
+static inline vreal vset(GLfloat a) { return _mm_set1_ps(a); }
+static inline vreal vload(const GLfloat* p) { return _mm_loadu_ps(p); }
+static inline void vstore(GLfloat* p, vreal a) { _mm_storeu_ps(p, a); }
+static inline vreal vadd(vreal a, vreal b) { return _mm_add_ps(a, b); }
+static inline vreal vsub(vreal a, vreal b) { return _mm_sub_ps(a, b); }
+static inline vreal vmul(vreal a, vreal b) { return _mm_mul_ps(a, b); }
+static inline vreal vrsqrt(vreal a) { return _mm_rsqrt_ps(a); }
+static inline vreal vand(vreal a, vreal b) { return _mm_and_ps(a, b); }
+static inline vreal vgreater(vreal a, vreal b) { return _mm_cmpgt_ps(a, b); }
+static inline vreal vlanes() { return _mm_setr_ps(0, 1, 2, 3); }
+static inline GLfloat vsum(vreal a)
+{
+	__m128 s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+#endif
+
+// 1 / r^3 from r^2, zero where r^2 is zero (a body and itself, or padding at the same place)
+// float rsqrt has 12 bits, one Newton step y' = y (1.5 - 0.5 r^2 y^2) brings it to about 23
+// the double vrsqrt divides by the square root and is exact already
+static inline vreal inverseCube(vreal r2)
+{
+	vreal y = vrsqrt(r2);
+#ifndef LAB5_DOUBLE_PRECISION
+	y = vmul(y, vsub(vset(1.5f), vmul(vmul(vset(0.5f), r2), vmul(y, y))));
+#endif
+	y = vand(y, vgreater(r2, vset(0.0f)));
+	return vmul(y, vmul(y, y));
+}
+
+
+GravityKernel::GravityKernel() : G(6.67E-11f), softening(0), count(0)
+{
+}
+
+GravityKernel::GravityKernel(Real G, Real softening) : G(G), softening(softening), count(0)
+{
+}
+
+void GravityKernel::load(const SphereStore& bodies)
+{
+	count = (GLuint)bodies.size();
+	// padding bodies have no mass and sit far away, a padding body close to a real one
+	// could make r^2 so small that 1 / r^3 overflows and 0 mass times infinity is NaN
+	const Real FAR_AWAY = Real(1E18);
+	GLuint padded = (count + WIDTH - 1) / WIDTH * WIDTH;
+	x.assign(padded, FAR_AWAY);
+	y.assign(padded, FAR_AWAY);
+	z.assign(padded, FAR_AWAY);
+	m.assign(padded, 0.0f);
+	for (GLuint i = 0; i < count; i++) {
+		x[i] = bodies.position[i].x;
+		y[i] = bodies.position[i].y;
+		z[i] = bodies.position[i].z;
+		m[i] = bodies.mass[i];
+	}
+}
+
+// the j side of a pair is updated in the same pass as the i side, j runs over one tile at a time
+// so the tile's arrays stay in L1 while all i before the tile's end pass over it
+void GravityKernel::addPairForces(RealVec3* force)
+{
+	GLuint padded = (GLuint)x.size();
+	fx.assign(padded, 0.0f);
+	fy.assign(padded, 0.0f);
+	fz.assign(padded, 0.0f);
+	vreal eps2 = vset(softening * softening);
+	vreal lanes = vlanes();
+
+	for (GLuint tileStart = 0; tileStart < padded; tileStart += TILE) {
+		GLuint tileEnd = tileStart + TILE < padded ? tileStart + TILE : padded;
+		for (GLuint i = 0; i < count && i < tileEnd; i++) {
+			vreal xi = vset(x[i]), yi = vset(y[i]), zi = vset(z[i]);
+			vreal gmi = vset(G * m[i]);
+			vreal sx = vset(0.0f), sy = vset(0.0f), sz = vset(0.0f);
+			// start at the vector holding i + 1, lanes up to i are masked out below
+			GLuint first = (i + 1) / WIDTH * WIDTH;
+			GLuint j = first > tileStart ? first : tileStart;
+			vreal lastPaired = vset((Real)i);
+			for (; j < tileEnd; j += WIDTH) {
+				vreal dx = vsub(vload(&x[j]), xi);
+				vreal dy = vsub(vload(&y[j]), yi);
+				vreal dz = vsub(vload(&z[j]), zi);
+				vreal r2 = vadd(vadd(vmul(dx, dx), vmul(dy, dy)), vadd(vmul(dz, dz), eps2));
+				vreal w = vmul(vmul(gmi, vload(&m[j])), inverseCube(r2));
+				w = vand(w, vgreater(vadd(lanes, vset((Real)j)), lastPaired));
+				vreal wx = vmul(w, dx), wy = vmul(w, dy), wz = vmul(w, dz);
+				sx = vadd(sx, wx);
+				sy = vadd(sy, wy);
+				sz = vadd(sz, wz);
+				vstore(&fx[j], vsub(vload(&fx[j]), wx));
+				vstore(&fy[j], vsub(vload(&fy[j]), wy));
+				vstore(&fz[j], vsub(vload(&fz[j]), wz));
+			}
+			fx[i] += vsum(sx);
+			fy[i] += vsum(sy);
+			fz[i] += vsum(sz);
+		}
+	}
+
+	for (GLuint i = 0; i < count; i++)
+		force[i] += RealVec3(fx[i], fy[i], fz[i]);
+}
+
+// like addPairForces, j runs over one tile at a time for all rows
+void GravityKernel::addRowForces(const GLuint* rows, GLuint begin, GLuint end, RealVec3* force) const
+{
+	GLuint padded = (GLuint)x.size();
+	vreal eps2 = vset(softening * softening);
+	for (GLuint tileStart = 0; tileStart < padded; tileStart += TILE) {
+		GLuint tileEnd = tileStart + TILE < padded ? tileStart + TILE : padded;
+		for (GLuint k = begin; k < end; k++) {
+			GLuint i = rows ? rows[k] : k;
+			vreal xi = vset(x[i]), yi = vset(y[i]), zi = vset(z[i]);
+			vreal gmi = vset(G * m[i]);
+			vreal sx = vset(0.0f), sy = vset(0.0f), sz = vset(0.0f);
+			// body i itself adds nothing: without softening its r^2 is zero, with softening its d is
+			for (GLuint j = tileStart; j < tileEnd; j += WIDTH) {
+				vreal dx = vsub(vload(&x[j]), xi);
+				vreal dy = vsub(vload(&y[j]), yi);
+				vreal dz = vsub(vload(&z[j]), zi);
+				vreal r2 = vadd(vadd(vmul(dx, dx), vmul(dy, dy)), vadd(vmul(dz, dz), eps2));
+				vreal w = vmul(vmul(gmi, vload(&m[j])), inverseCube(r2));
+				sx = vadd(sx, vmul(w, dx));
+				sy = vadd(sy, vmul(w, dy));
+				sz = vadd(sz, vmul(w, dz));
+			}
+			force[i] += RealVec3(vsum(sx), vsum(sy), vsum(sz));
+		}
+	}
+}
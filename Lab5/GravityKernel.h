@@ -0,0 +1,38 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "RigidBody.h"
+
+// direct summation of gravity over structure-of-arrays copies of the positions and masses
+// evaluates 8 (AVX) or 4 (SSE) float pairs per instruction with rsqrt refined by one Newton step,
+// or half as many double pairs with a full square root
+// the arrays are padded with massless bodies so no loop needs a scalar tail
+class GravityKernel {
+public:
+	// bodies per tile; a tile of positions, masses and force sums (7 Reals per body, 14 KB) stays in L1
+	static const GLuint TILE = 2048 / sizeof(Real);
+
+	Real G;
+	// Plummer softening length, distances are replaced by sqrt(d^2 + softening^2)
+	Real softening;
+
+	GravityKernel();
+	GravityKernel(Real G, Real softening);
+
+	// copy positions and masses, call whenever the bodies moved and before the force functions
+	void load(const SphereStore& bodies);
+	// add the forces between all pairs to force[0] ... force[n - 1], every pair is evaluated once
+	void addPairForces(RealVec3* force);
+	// add the force of all bodies on body i to force[i] for i = rows[begin] ... rows[end - 1],
+	// or i = begin ... end - 1 if rows is NULL
+	// twice the work of addPairForces, but rows only read the loaded arrays,
+	// so several threads can run them at once
+	void addRowForces(const GLuint* rows, GLuint begin, GLuint end, RealVec3* force) const;
+
+private:
+	GLuint count;
+	std::vector<Real> x, y, z, m;
+	// force sums of addPairForces
+	std::vector<Real> fx, fy, fz;
+};
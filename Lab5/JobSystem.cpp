@@ -0,0 +1,136 @@
+#include "JobSystem.h"
+
+
+JobSystem::JobSystem() : body(NULL), pending(0), generation(0), stopping(false)
+{
+	start(0);
+}
+
+JobSystem::JobSystem(GLuint threads) : body(NULL), pending(0), generation(0), stopping(false)
+{
+	start(threads);
+}
+
+JobSystem::~JobSystem()
+{
+	stop();
+}
+
+GLuint JobSystem::threadCount() const
+{
+	return (GLuint)queues.size();
+}
+
+void JobSystem::setThreadCount(GLuint threads)
+{
+	stop();
+	start(threads);
+}
+
+// create one queue per thread and threads - 1 workers, the caller of parallelFor works on queue 0
+void JobSystem::start(GLuint threads)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 1;
+	stopping = false;
+	for (GLuint i = 0; i < threads; i++)
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+	for (GLuint i = 1; i < threads; i++)
+		workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+void JobSystem::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+	queues.clear();
+}
+
+void JobSystem::parallelFor(GLuint first, GLuint last, GLuint grain, const std::function<void(GLuint, GLuint)>& body)
+{
+	if (last <= first) return;
+	if (grain == 0) grain = 1;
+	GLuint threads = threadCount();
+	if (threads <= 1 || last - first <= grain) {
+		body(first, last);
+		return;
+	}
+
+	// give each queue a run of neighbouring chunks so threads mostly touch their own part of the data
+	GLuint chunkCount = (last - first + grain - 1) / grain;
+	this->body = &body;
+	pending = chunkCount;
+	for (GLuint q = 0; q < threads; q++) {
+		std::lock_guard<std::mutex> lock(queues[q]->mutex);
+		for (GLuint c = q * chunkCount / threads; c < (q + 1) * chunkCount / threads; c++) {
+			Chunk chunk;
+			chunk.begin = first + c * grain;
+			chunk.end = chunk.begin + grain < last ? chunk.begin + grain : last;
+			queues[q]->chunks.push_back(chunk);
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		generation++;
+	}
+	wake.notify_all();
+
+	// work on our own queue, then steal, until every chunk is finished
+	while (pending.load() > 0) {
+		if (!runChunk(0))
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::workerLoop(GLuint index)
+{
+	GLuint seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping) return;
+			seen = generation;
+		}
+		while (runChunk(index)) {}
+	}
+}
+
+// run one chunk from our own queue or stolen from another, false if all queues are empty
+GLboolean JobSystem::runChunk(GLuint index)
+{
+	Chunk chunk;
+	GLboolean found = false;
+	{
+		WorkQueue& own = *queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.chunks.empty()) {
+			chunk = own.chunks.back();
+			own.chunks.pop_back();
+			found = true;
+		}
+	}
+	GLuint threads = threadCount();
+	for (GLuint k = 1; !found && k < threads; k++) {
+		WorkQueue& victim = *queues[(index + k) % threads];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.chunks.empty()) {
+			chunk = victim.chunks.front();
+			victim.chunks.pop_front();
+			found = true;
+		}
+	}
+	if (!found) return false;
+
+	(*body)(chunk.begin, chunk.end);
+	pending.fetch_sub(1);
+	return true;
+}
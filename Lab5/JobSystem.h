@@ -0,0 +1,59 @@
+#pragma once
+#include <glad/glad.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work-stealing thread pool
+// parallelFor deals the chunks of an index range out to one queue per thread
+// a thread takes chunks from the back of its own queue and, once it is empty,
+// steals from the front of the other queues
+class JobSystem {
+public:
+	// use all hardware threads
+	JobSystem();
+	JobSystem(GLuint threads);
+	~JobSystem();
+
+	// number of threads running chunks, including the thread calling parallelFor
+	GLuint threadCount() const;
+	// replace the worker threads, 0 uses all hardware threads
+	void setThreadCount(GLuint threads);
+
+	// call body(begin, end) for chunks of at most grain indices covering [first, last)
+	// and return once all of them are done
+	void parallelFor(GLuint first, GLuint last, GLuint grain, const std::function<void(GLuint, GLuint)>& body);
+
+private:
+	struct Chunk {
+		GLuint begin;
+		GLuint end;
+	};
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<Chunk> chunks;
+	};
+
+	// queues[0] belongs to the thread calling parallelFor, queues[i] to workers[i - 1]
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> workers;
+	const std::function<void(GLuint, GLuint)>* body;
+	// chunks of the current parallelFor not finished yet
+	std::atomic<GLuint> pending;
+
+	// sleeping workers wait for generation to change
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+	GLuint generation;
+	GLboolean stopping;
+
+	void start(GLuint threads);
+	void stop();
+	void workerLoop(GLuint index);
+	GLboolean runChunk(GLuint index);
+};
@@ -11,9 +11,18 @@
 #include "Camera.h"
 #include "Model.h"
 #include "RigidBody.h"
+#include "Octree.h"
+#include "BlockTimestep.h"
+#include "GravityKernel.h"
 #include "MyMath.h"
+#include "JobSystem.h"
+#include "SweepAndPrune.h"
 
 #include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
 
@@ -41,9 +50,16 @@ GLfloat lastFrame = 0.0f;
 // frame index
 GLint frameCount = 0;
 
+// fixed time step of the headless mode
+const GLfloat FIXED_DT = 1.0f / 60.0f;
+
+// number of planets created by init()
+GLuint planetCount = 4;
+
 // object list
-std::vector<Sphere> sphereList;
-std::vector<glm::vec3> colorList;
+SphereStore sphereList;
+// handle of the star, which is drawn emissive
+GLuint starHandle = 0;
 
 // lighting
 glm::vec3 lightPos[] = {
@@ -52,41 +68,137 @@ glm::vec3 lightPos[] = {
 };
 
 // Universal gravity constant
-GLfloat G = 6.67E-11;
+Real G = Real(6.67E-11);
+
+// gravity solver: 1 for direct summation, 2 for Barnes-Hut
+GLint forceMode = 1;
+Octree octree(0.5f);
+// vectorized direct summation, without softening
+GravityKernel gravity(G, 0.0f);
+
+// integration scheme of simulate
+SphereStore::Integrator integrator = SphereStore::EULER;
+// leapfrog with a time step per body instead of integrator
+GLboolean useBlockSteps = false;
+BlockTimestep blockTimestep(6, 0.02f);
+
+// merge spheres that touch instead of letting them pass through each other
+GLboolean mergeOnContact = false;
+SweepAndPrune broadphase;
+// body each body was merged into during mergeContacts, or the body itself
+std::vector<GLuint> mergedInto;
+
+// worker threads of the simulation
+JobSystem jobs;
 
 //GLvoid drawBox(GLuint VAO, Shader modelShader);
 //GLvoid resolveCollision(Sphere& a, Sphere& b, glm::vec3 normal);
-GLvoid resolveGravitationalForce(Sphere* a, Sphere* b);
+GLvoid resolveGravitationalForce(GLuint a);
+GLvoid computeForces();
+GLvoid computeActiveForces(const std::vector<GLuint>& active);
+GLvoid reportBlockSteps();
+GLvoid reportGravityKernel();
+GLvoid reportPrecision();
+GLvoid reportEnergyDrift();
+GLvoid reportBarnesHut();
+GLvoid simulate(GLfloat dt);
+GLuint mergeContacts();
+GLint runHeadless(GLint argc, char** argv);
+GLint runScaling(GLint argc, char** argv);
+GLint runAccretion(GLint argc, char** argv);
 
 //================================
 // init
 //================================
 GLvoid init(GLvoid) {
 	sphereList.clear();
+	sphereList.reserve(planetCount + 1);
+	blockTimestep.reset();
 	const glm::vec3 ZERO_VEC = glm::vec3(0);
 	
-	GLfloat M = 1E15; // mass of star
-	GLfloat d = 10; // distance from center
-	GLfloat coeff = 0.9f; // coefficient to the velocity
-	GLfloat radius = 0;
+	Real M = 1E15; // mass of star
 	// add star: center of the system at 0,0,0
-	sphereList.push_back(Sphere(ZERO_VEC, ZERO_VEC, ZERO_VEC, ZERO_VEC, ZERO_VEC, M, 0, 0, 10));
-	colorList.push_back(glm::vec3(0.9, 0.9, 0.0));
+	starHandle = sphereList.add(Sphere(ZERO_VEC, ZERO_VEC, ZERO_VEC, ZERO_VEC, ZERO_VEC, M, 0, 0, 10), glm::vec3(0.9, 0.9, 0.0));
 	// add planets
-	for (int i = 0; i < 4; i++) {
-		coeff += 0.1f;
-		d += 10;
-		radius += 1;
-		sphereList.push_back(Sphere(glm::vec3(0, 0, d), glm::vec3(glm::sqrt(coeff * G * M / d), 0, 0), ZERO_VEC, ZERO_VEC, ZERO_VEC, 10, 0, 0, radius));
+	for (GLuint i = 0; i < planetCount; i++) {
+		Real d = Real(20) + Real(10) * i; // distance from center
+		GLfloat coeff = 1.0f + 0.1f * (i % 4); // coefficient to the velocity
+		GLfloat radius = 1.0f + (i % 4);
+		// the first four planets start in line on the z axis, the others at a random angle
+		GLfloat angle = i < 4 ? 0.0f : glm::linearRand(0.0f, 2.0f * glm::pi<GLfloat>());
+		RealVec3 position = d * RealVec3(glm::sin(angle), 0, glm::cos(angle));
+		RealVec3 linearVelocity = glm::sqrt(coeff * G * M / d) * RealVec3(glm::cos(angle), 0, -glm::sin(angle));
 		// random colors
 		glm::vec3 random_color = glm::linearRand(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f));
-		colorList.push_back(random_color);
+		sphereList.add(Sphere(position, linearVelocity, ZERO_VEC, ZERO_VEC, ZERO_VEC, 10, 0, 0, radius), random_color);
 	}
 
 }
 
-GLint main()
+GLint main(GLint argc, char** argv)
 {
+	// run "Lab5 report" to compare Barnes-Hut against direct summation instead of opening a window
+	if (argc > 1 && strcmp(argv[1], "report") == 0) {
+		reportBarnesHut();
+		return 0;
+	}
+	// run "Lab5 energy" to compare the energy drift of the integrators instead of opening a window
+	if (argc > 1 && strcmp(argv[1], "energy") == 0) {
+		reportEnergyDrift();
+		return 0;
+	}
+	// run "Lab5 blocksteps" to compare block time steps against one global step instead of opening a window
+	if (argc > 1 && strcmp(argv[1], "blocksteps") == 0) {
+		reportBlockSteps();
+		return 0;
+	}
+	// run "Lab5 gravity" to time the direct summation kernel instead of opening a window
+	if (argc > 1 && strcmp(argv[1], "gravity") == 0) {
+		reportGravityKernel();
+		return 0;
+	}
+	// run "Lab5 precision" to simulate the inner solar system at its real scale instead of opening a window
+	if (argc > 1 && strcmp(argv[1], "precision") == 0) {
+		reportPrecision();
+		return 0;
+	}
+	// run "Lab5 headless <bodies> <steps> <seed> [theta]" to simulate without a window
+	if (argc > 1 && strcmp(argv[1], "headless") == 0)
+		return runHeadless(argc, argv);
+	// run "Lab5 scaling <bodies> <steps> <threads> [theta]" to time the simulation with 1 ... threads threads
+	if (argc > 1 && strcmp(argv[1], "scaling") == 0)
+		return runScaling(argc, argv);
+	// run "Lab5 accretion <bodies> <seconds> <seed>" to simulate a disk of merging planets without a window
+	if (argc > 1 && strcmp(argv[1], "accretion") == 0)
+		return runAccretion(argc, argv);
+
+	std::cout << "Select gravity mode: \n 1: Direct summation \n 2: Barnes-Hut" << "\n";
+	std::cin >> forceMode;
+	if (forceMode == 2) {
+		std::cout << "Enter opening angle theta:" << "\n";
+		std::cin >> octree.theta;
+	}
+	else if (forceMode != 1) {
+		exit(1);
+	}
+	GLint integratorMode;
+	std::cout << "Select integrator: \n 1: Euler \n 2: Leapfrog \n 3: Yoshida 4th order \n 4: Runge-Kutta 4th order \n 5: Leapfrog with block time steps" << "\n";
+	std::cin >> integratorMode;
+	if (integratorMode < 1 || integratorMode > 5) {
+		exit(1);
+	}
+	if (integratorMode == 5)
+		useBlockSteps = true;
+	else
+		integrator = (SphereStore::Integrator)(integratorMode - 1);
+	GLint collisionMode;
+	std::cout << "Select collisions: \n 1: Pass through \n 2: Merge on contact" << "\n";
+	std::cin >> collisionMode;
+	if (collisionMode < 1 || collisionMode > 2) {
+		exit(1);
+	}
+	mergeOnContact = collisionMode == 2;
+
 	init();
 	// glfw: initialize and configure
 	// ------------------------------
@@ -130,6 +242,7 @@ GLint main()
 	// build and compile shaders
 	// -------------------------
 	Shader modelShader("model.vs", "model.fs");
+	GLint modelLoc = modelShader.location("model");
 	Shader floorShader("background.vs", "background.fs");
 
 	// load models
@@ -141,6 +254,9 @@ GLint main()
 	// draw in wireframe
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+	// per-planet transforms and colors, refilled every frame
+	std::vector<InstanceData> planetInstances;
+
 	// render loop
 	// -----------
 	while (!glfwWindowShouldClose(window))
@@ -162,9 +278,10 @@ GLint main()
 
 		// enable shader before setting uniforms
 		modelShader.use();
-		modelShader.setVec3("lights[0].position", lightPos[0]);
-		modelShader.setVec3("lights[1].position", lightPos[1]);
-		modelShader.setVec3("viewPos", camera.Position);
+		// everything is drawn relative to the camera, so float only has to resolve what is near it
+		modelShader.setVec3("lights[0].position", lightPos[0] - camera.Position);
+		modelShader.setVec3("lights[1].position", lightPos[1] - camera.Position);
+		modelShader.setVec3("viewPos", glm::vec3(0.0f));
 
 		// light properties
 
@@ -191,39 +308,40 @@ GLint main()
 
 		// view/projection transformations
 		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (GLfloat)SCR_WIDTH / (GLfloat)SCR_HEIGHT, 0.1f, 1000.0f);
-		glm::mat4 view = camera.GetViewMatrix();
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f), camera.Front, camera.Up);
 		modelShader.setMat4("projection", projection);
 		modelShader.setMat4("view", view);
 
-		// move spheres out of intersection
-		for (int i = 0; i < sphereList.size() - 1; i++) {
-			Sphere* a = &sphereList[i];
-			for (int j = i + 1; j < sphereList.size(); j++) {
-				Sphere* b = &sphereList[j];
-				resolveGravitationalForce(a, b);
-			}
-		}
-		// draw spheres
-		for (int i = 0; i < sphereList.size(); i++) {
-			Sphere* s = &sphereList[i];
+		// update state of all spheres
+		simulate(deltaTime);
 
-			// draw according to Sphere properties
-			glm::vec3 posVec = s->position;
-			GLfloat radius = s->radius;
+		// draw spheres
+		GLuint star = sphereList.index(starHandle);
+		RealVec3 eye = RealVec3(camera.Position);
+		planetInstances.clear();
+		for (GLuint i = 0; i < sphereList.size(); i++) {
+			// draw according to Sphere properties, subtracting the camera position in full precision
+			glm::vec3 posVec = glm::vec3(sphereList.position[i] - eye);
+			GLfloat radius = sphereList.radius[i];
 			glm::mat4 model;
 			model = MyUtil::translate(glm::mat4(1.0), posVec);
 			model = MyUtil::scale(model, glm::vec3(radius));
-			modelShader.setMat4("model", model);
-			// render the star differently: inverse the normal(making it emissive)
-			if (i == 0) modelShader.setInt("inverseNormal", 1);
-			else modelShader.setInt("inverseNormal", 0);
-			// assign diffuse colors
-			modelShader.setVec3("material.diffuse", colorList[i]);
-			sphere.Draw(modelShader);
-
-			// update new state for sphere: move according to velocity and deltaTime
-			s->update(deltaTime);
+			if (i == star) {
+				// render the star differently: inverse the normal(making it emissive)
+				modelShader.setMat4(modelLoc, model);
+				modelShader.setInt("inverseNormal", 1);
+				modelShader.setVec3("material.diffuse", sphereList.color[i]);
+				sphere.Draw(modelShader);
+				modelShader.setInt("inverseNormal", 0);
+			}
+			else {
+				// planets are drawn together below
+				planetInstances.push_back({ model, sphereList.color[i] });
+			}
 		}
+		modelShader.setInt("instanced", 1);
+		sphere.DrawInstanced(modelShader, planetInstances);
+		modelShader.setInt("instanced", 0);
 
 		
 		// draw physics simulation bounding box
@@ -306,11 +424,587 @@ GLvoid scroll_callback(GLFWwindow* window, GLdouble xoffset, GLdouble yoffset)
 	camera.ProcessMouseScroll(static_cast<GLfloat>(yoffset));
 }
 
-GLvoid resolveGravitationalForce(Sphere* a, Sphere* b) {
-	
-	glm::vec3 diff = a->position - b->position;
-	GLfloat d_sqr = glm::dot(diff, diff);
-	GLfloat force = G * a->mass * b->mass / d_sqr;
-	a->applyForce(-force * glm::normalize(diff));
-	b->applyForce(force * glm::normalize(diff));
+// apply gravity between sphere a and every sphere after it, so each pair is visited once
+// scalar reference for GravityKernel
+GLvoid resolveGravitationalForce(GLuint a) {
+	const RealVec3* position = sphereList.position.data();
+	const Real* mass = sphereList.mass.data();
+	RealVec3* force = sphereList.force.data();
+	size_t n = sphereList.size();
+
+	RealVec3 forceA(0);
+	for (size_t b = a + 1; b < n; b++) {
+		RealVec3 diff = position[a] - position[b];
+		Real d_sqr = glm::dot(diff, diff);
+		Real f = G * mass[a] * mass[b] / d_sqr;
+		forceA -= f * glm::normalize(diff);
+		force[b] += f * glm::normalize(diff);
+	}
+	force[a] += forceA;
+}
+
+// add gravity between all spheres to their forces
+GLvoid computeForces()
+{
+	if (forceMode == 2) {
+		octree.build(sphereList);
+		// the tree is only read while computing forces
+		jobs.parallelFor(0, (GLuint)sphereList.size(), 64, [&](GLuint begin, GLuint end) {
+			for (GLuint i = begin; i < end; i++)
+				sphereList.applyForce(i, octree.computeForce(sphereList, i, G));
+		});
+	}
+	else {
+		gravity.load(sphereList);
+		// threads sum whole rows so no two of them write the same force
+		if (jobs.threadCount() > 1) {
+			jobs.parallelFor(0, (GLuint)sphereList.size(), 64, [&](GLuint begin, GLuint end) {
+				gravity.addRowForces(NULL, begin, end, sphereList.force.data());
+			});
+		}
+		else
+			gravity.addPairForces(sphereList.force.data());
+	}
+}
+
+// add gravity from all spheres to the forces of the spheres in active
+GLvoid computeActiveForces(const std::vector<GLuint>& active)
+{
+	if (active.empty()) return;
+	if (forceMode == 2) {
+		// every body is active at the synchronization point ending a block step, build the tree
+		// there and between those only move its centers of mass with the drifting bodies, so a
+		// sub-step with few active bodies does not pay for sorting all of them
+		if (active.size() == sphereList.size() || octree.bodyIndex.size() != sphereList.size())
+			octree.build(sphereList);
+		else
+			octree.refit(sphereList);
+		jobs.parallelFor(0, (GLuint)active.size(), 64, [&](GLuint begin, GLuint end) {
+			for (GLuint k = begin; k < end; k++)
+				sphereList.applyForce(active[k], octree.computeForce(sphereList, active[k], G));
+		});
+	}
+	else {
+		// copying the positions is linear like the drift of every tick, the rows cost active * N
+		gravity.load(sphereList);
+		jobs.parallelFor(0, (GLuint)active.size(), 64, [&](GLuint begin, GLuint end) {
+			gravity.addRowForces(active.data(), begin, end, sphereList.force.data());
+		});
+	}
+}
+
+// apply gravity between all spheres and advance them by dt
+GLvoid simulate(GLfloat dt)
+{
+	if (useBlockSteps) {
+		blockTimestep.step(sphereList, dt, computeActiveForces);
+	}
+	else if (integrator != SphereStore::EULER) {
+		// the other schemes evaluate forces at intermediate positions
+		sphereList.update(dt, integrator, computeForces);
+	}
+	else {
+		computeForces();
+		// update new state for spheres: move according to velocity and dt
+		jobs.parallelFor(0, (GLuint)sphereList.size(), 1024, [&](GLuint begin, GLuint end) {
+			sphereList.update(dt, begin, end);
+		});
+	}
+
+	if (mergeOnContact)
+		mergeContacts();
+}
+
+// merge every pair of touching spheres into the heavier one and remove the lighter one
+// a sphere touching several others in one step absorbs all of them, one after another
+// returns the number of removed spheres
+GLuint mergeContacts()
+{
+	broadphase.update(sphereList);
+	if (broadphase.pairs.empty()) return 0;
+
+	GLuint n = (GLuint)sphereList.size();
+	mergedInto.resize(n);
+	for (GLuint i = 0; i < n; i++)
+		mergedInto[i] = i;
+	for (size_t k = 0; k < broadphase.pairs.size(); k++) {
+		GLuint a = broadphase.pairs[k].first;
+		GLuint b = broadphase.pairs[k].second;
+		while (mergedInto[a] != a) a = mergedInto[a];
+		while (mergedInto[b] != b) b = mergedInto[b];
+		if (a == b) continue;
+
+		// test the bodies as they are now, earlier merges may have moved and grown them
+		RealVec3 normal;
+		Real depth;
+		if (!sphereList.intersect(a, b, normal, depth)) continue;
+		if (sphereList.mass[a] < sphereList.mass[b])
+			std::swap(a, b);
+		sphereList.merge(a, b);
+		mergedInto[b] = a;
+	}
+	return sphereList.compact();
+}
+
+// step the system at FIXED_DT without creating a window or GL context
+// usage: Lab5 headless [bodies] [steps] [seed] [theta]
+// direct summation is used unless theta is given
+GLint runHeadless(GLint argc, char** argv)
+{
+	GLuint bodyCount = planetCount + 1;
+	GLuint steps = 1000;
+	GLuint seed = 0;
+	if (argc > 2) bodyCount = (GLuint)strtoul(argv[2], NULL, 10);
+	if (argc > 3) steps = (GLuint)strtoul(argv[3], NULL, 10);
+	if (argc > 4) seed = (GLuint)strtoul(argv[4], NULL, 10);
+	if (argc > 5) {
+		forceMode = 2;
+		octree.theta = (GLfloat)atof(argv[5]);
+	}
+	// one of the bodies is the star
+	planetCount = bodyCount > 0 ? bodyCount - 1 : 0;
+
+	// glm::linearRand draws from std::rand
+	srand(seed);
+	init();
+
+	auto start = std::chrono::steady_clock::now();
+	for (GLuint step = 0; step < steps; step++)
+		simulate(FIXED_DT);
+	std::chrono::duration<GLdouble> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << "bodies: " << sphereList.size()
+		<< "\tsteps: " << steps
+		<< "\tseconds: " << elapsed.count()
+		<< "\tsteps/s: " << steps / elapsed.count() << std::endl;
+	return 0;
+}
+
+// time the simulation with 1, 2, 4, ... threads up to all hardware threads
+// usage: Lab5 scaling [bodies] [steps] [threads] [theta]
+// direct summation is used unless theta is given
+GLint runScaling(GLint argc, char** argv)
+{
+	GLuint steps = 10;
+	GLuint maxThreads = std::thread::hardware_concurrency();
+	GLuint bodyCount = 4000;
+	if (argc > 2) bodyCount = (GLuint)strtoul(argv[2], NULL, 10);
+	if (argc > 3) steps = (GLuint)strtoul(argv[3], NULL, 10);
+	if (argc > 4) maxThreads = (GLuint)strtoul(argv[4], NULL, 10);
+	if (maxThreads == 0) maxThreads = 1;
+	if (argc > 5) {
+		forceMode = 2;
+		octree.theta = (GLfloat)atof(argv[5]);
+	}
+
+	std::vector<GLuint> threadCounts;
+	for (GLuint t = 1; t < maxThreads; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(maxThreads);
+
+	GLdouble baseline = 0;
+	for (size_t k = 0; k < threadCounts.size(); k++) {
+		jobs.setThreadCount(threadCounts[k]);
+		// same start state for every thread count
+		srand(0);
+		planetCount = bodyCount > 0 ? bodyCount - 1 : 0;
+		init();
+
+		auto start = std::chrono::steady_clock::now();
+		for (GLuint step = 0; step < steps; step++)
+			simulate(FIXED_DT);
+		std::chrono::duration<GLdouble> elapsed = std::chrono::steady_clock::now() - start;
+
+		GLdouble rate = steps / elapsed.count();
+		if (k == 0) baseline = rate;
+		std::cout << "threads: " << threadCounts[k]
+			<< "\tsteps/s: " << rate
+			<< "\tspeedup: " << rate / baseline
+			<< "\tefficiency: " << rate / baseline / threadCounts[k] << std::endl;
+	}
+	jobs.setThreadCount(0);
+	return 0;
+}
+
+// compare Barnes-Hut forces against direct summation for 10k, 100k and 1M random bodies
+// the direct sum is evaluated for a sample of bodies only and its time is scaled to all bodies
+GLvoid reportBarnesHut() {
+	const glm::vec3 ZERO_VEC = glm::vec3(0);
+	const GLuint sampleSize = 1000;
+	GLfloat thetas[] = { 0.3f, 0.5f, 0.7f, 1.0f };
+
+	for (GLuint n = 10000; n <= 1000000; n *= 10) {
+		// bodies spread uniformly in a ball
+		SphereStore bodies;
+		bodies.reserve(n);
+		for (GLuint i = 0; i < n; i++) {
+			glm::vec3 random_position = glm::ballRand(1000.0f);
+			GLfloat random_mass = glm::linearRand(1E6f, 1E7f);
+			bodies.add(Sphere(random_position, ZERO_VEC, ZERO_VEC, ZERO_VEC, ZERO_VEC, random_mass, 0, 0, 1), glm::vec3(1));
+		}
+
+		// reference forces on the sample by direct summation in double precision
+		std::vector<glm::dvec3> reference(sampleSize);
+		for (GLuint s = 0; s < sampleSize; s++) {
+			GLuint i = s * (n / sampleSize);
+			glm::dvec3 force(0);
+			for (GLuint j = 0; j < n; j++) {
+				if (j == i) continue;
+				glm::dvec3 diff = glm::dvec3(bodies.position[j]) - glm::dvec3(bodies.position[i]);
+				GLdouble d_sqr = glm::dot(diff, diff);
+				force += (GLdouble)G * bodies.mass[i] * bodies.mass[j] / d_sqr * glm::normalize(diff);
+			}
+			reference[s] = force;
+		}
+
+		// time the direct sum on the sample and scale it to all bodies
+		// every pair is evaluated once in the render loop, hence the factor 0.5
+		std::vector<RealVec3> direct(sampleSize, RealVec3(0));
+		auto start = std::chrono::steady_clock::now();
+		for (GLuint s = 0; s < sampleSize; s++) {
+			GLuint i = s * (n / sampleSize);
+			for (GLuint j = 0; j < n; j++) {
+				if (j == i) continue;
+				RealVec3 diff = bodies.position[i] - bodies.position[j];
+				Real d_sqr = glm::dot(diff, diff);
+				Real force = G * bodies.mass[i] * bodies.mass[j] / d_sqr;
+				direct[s] -= force * glm::normalize(diff);
+			}
+		}
+		std::chrono::duration<GLdouble> elapsed = std::chrono::steady_clock::now() - start;
+		GLdouble directSeconds = elapsed.count() * n / sampleSize * 0.5;
+		GLdouble directError = 0;
+		for (GLuint s = 0; s < sampleSize; s++)
+			directError += glm::length(glm::dvec3(direct[s]) - reference[s]) / glm::length(reference[s]);
+		std::cout << "bodies: " << n
+			<< "\tdirect sum (est.): " << directSeconds << " s/step"
+			<< "\tmean rel. error: " << directError / sampleSize << std::endl;
+
+		for (GLfloat theta : thetas) {
+			Octree tree(theta);
+			std::vector<RealVec3> forces(n);
+			start = std::chrono::steady_clock::now();
+			tree.build(bodies);
+			for (GLuint i = 0; i < n; i++)
+				forces[i] = tree.computeForce(bodies, i, G);
+			elapsed = std::chrono::steady_clock::now() - start;
+
+			// relative error of the force vector over the sample
+			GLdouble sumError = 0, maxError = 0;
+			for (GLuint s = 0; s < sampleSize; s++) {
+				GLuint i = s * (n / sampleSize);
+				GLdouble error = glm::length(glm::dvec3(forces[i]) - reference[s]) / glm::length(reference[s]);
+				sumError += error;
+				maxError = glm::max(maxError, error);
+			}
+			std::cout << "\ttheta: " << theta
+				<< "\tbarnes-hut: " << elapsed.count() << " s/step"
+				<< "\tspeedup: " << directSeconds / elapsed.count()
+				<< "\tmean rel. error: " << sumError / sampleSize
+				<< "\tmax rel. error: " << maxError << std::endl;
+		}
+	}
+}
+
+// kinetic plus potential energy of all spheres in double precision
+GLdouble totalEnergy() {
+	GLdouble energy = 0;
+	for (GLuint i = 0; i < sphereList.size(); i++) {
+		glm::dvec3 v = glm::dvec3(sphereList.linearVelocity[i]);
+		energy += 0.5 * sphereList.mass[i] * glm::dot(v, v);
+		for (GLuint j = i + 1; j < sphereList.size(); j++) {
+			GLdouble d = glm::distance(glm::dvec3(sphereList.position[i]), glm::dvec3(sphereList.position[j]));
+			energy -= (GLdouble)G * sphereList.mass[i] * sphereList.mass[j] / d;
+		}
+	}
+	return energy;
+}
+
+// simulate the star with 8 planets for 20 seconds (about 9 orbits of the inner planet) with halving time steps
+// and report the largest relative energy error of each integrator, then the largest time step
+// that keeps it below 1E-4 and the force evaluations per simulated second that step costs
+GLvoid reportEnergyDrift() {
+	const char* names[] = { "euler", "leapfrog", "yoshida4", "rk4" };
+	const GLfloat duration = 20.0f;
+	const GLdouble tolerance = 1E-4;
+	forceMode = 1;
+	planetCount = 8;
+
+	for (GLint k = 0; k < 4; k++) {
+		integrator = (SphereStore::Integrator)k;
+		GLuint evaluations = SphereStore::forceEvaluations(integrator);
+		GLfloat largestDt = 0;
+		for (GLfloat dt = 0.25f; dt > 1.0f / 4000.0f; dt *= 0.5f) {
+			srand(0);
+			init();
+			GLdouble initialEnergy = totalEnergy();
+			GLdouble maxError = 0;
+			GLuint steps = (GLuint)(duration / dt + 0.5f);
+			for (GLuint step = 0; step < steps; step++) {
+				simulate(dt);
+				GLdouble error = glm::abs(totalEnergy() / initialEnergy - 1.0);
+				// a body thrown to infinity makes the energy NaN
+				if (!(error <= maxError)) maxError = glm::isnan(error) ? INFINITY : error;
+			}
+			if (largestDt == 0 && maxError < tolerance)
+				largestDt = dt;
+			std::cout << names[k]
+				<< "\tdt: " << dt
+				<< "\tforce evaluations: " << steps * evaluations
+				<< "\tmax energy error: " << maxError << std::endl;
+		}
+		std::cout << names[k] << "\tlargest dt with error < " << tolerance << ": ";
+		if (largestDt > 0)
+			std::cout << largestDt << "\tforce evaluations/s: " << evaluations / largestDt << std::endl;
+		else
+			std::cout << "none" << std::endl;
+	}
+	integrator = SphereStore::EULER;
+}
+
+// star with 200 planets 20 to 2010 apart, inner and outer orbital periods differ by a factor of 1000
+// simulate 10 seconds with block steps, then with leapfrog at the finest step the block steps used,
+// and compare force evaluations and energy error, the energy is checked every 0.25 seconds
+// with direct summation and with Barnes-Hut
+GLvoid reportBlockSteps() {
+	const GLfloat duration = 10.0f;
+	const GLfloat dt = 0.25f;
+	const char* modeNames[2] = { "direct", "barnes-hut" };
+	planetCount = 200;
+	GLuint finestLevel = 0;
+
+	for (GLint run = 0; run < 4; run++) {
+		forceMode = 1 + run / 2;
+		useBlockSteps = run % 2 == 0;
+		if (useBlockSteps)
+			finestLevel = 0;
+		integrator = SphereStore::LEAPFROG;
+		srand(0);
+		init();
+		GLdouble initialEnergy = totalEnergy();
+		GLdouble maxError = 0;
+		size_t evaluations = 0;
+		GLuint substeps = useBlockSteps ? 1 : 1u << finestLevel;
+		blockTimestep.forceEvaluations = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		for (GLfloat time = 0; time < duration; time += dt) {
+			for (GLuint s = 0; s < substeps; s++)
+				simulate(dt / substeps);
+			if (useBlockSteps) {
+				std::vector<GLuint> counts = blockTimestep.levelCounts();
+				for (GLuint l = 0; l < counts.size(); l++)
+					if (counts[l] > 0) finestLevel = glm::max(finestLevel, l);
+			}
+			else
+				evaluations += substeps * sphereList.size();
+			maxError = glm::max(maxError, glm::abs(totalEnergy() / initialEnergy - 1.0));
+		}
+		std::chrono::duration<GLdouble> elapsed = std::chrono::steady_clock::now() - start;
+		if (useBlockSteps)
+			evaluations = blockTimestep.forceEvaluations;
+
+		std::cout << modeNames[forceMode - 1] << "\t" << (useBlockSteps ? "block steps" : "global step")
+			<< "\tfinest dt: " << dt / (1u << finestLevel)
+			<< "\tforce evaluations: " << evaluations
+			<< "\tmax energy error: " << maxError
+			<< "\tseconds: " << elapsed.count();
+		if (useBlockSteps) {
+			std::vector<GLuint> counts = blockTimestep.levelCounts();
+			std::cout << "\tbodies per level:";
+			for (size_t l = 0; l < counts.size(); l++)
+				std::cout << " " << counts[l];
+		}
+		std::cout << std::endl;
+	}
+	useBlockSteps = false;
+	integrator = SphereStore::EULER;
+	forceMode = 1;
+}
+
+// time GravityKernel against the scalar pair loop for 1k to 50k random bodies and
+// compare both with double precision forces on a sample of bodies
+// the scalar loop is only timed up to 10k bodies
+GLvoid reportGravityKernel() {
+	const glm::vec3 ZERO_VEC = glm::vec3(0);
+	const GLuint sampleSize = 100;
+	GLuint sizes[] = { 1000, 5000, 10000, 50000 };
+
+	for (GLuint s = 0; s < 4; s++) {
+		GLuint n = sizes[s];
+		sphereList.clear();
+		sphereList.reserve(n);
+		for (GLuint i = 0; i < n; i++) {
+			glm::vec3 random_position = glm::ballRand(1000.0f);
+			GLfloat random_mass = glm::linearRand(1E6f, 1E7f);
+			sphereList.add(Sphere(random_position, ZERO_VEC, ZERO_VEC, ZERO_VEC, ZERO_VEC, random_mass, 0, 0, 1), glm::vec3(1));
+		}
+
+		GLdouble scalarSeconds = 0;
+		std::vector<RealVec3> scalar;
+		if (n <= 10000) {
+			auto start = std::chrono::steady_clock::now();
+			for (GLuint i = 0; i + 1 < n; i++)
+				resolveGravitationalForce(i);
+			scalarSeconds = std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - start).count();
+			scalar = sphereList.force;
+		}
+
+		std::vector<RealVec3> pairs(n, RealVec3(0));
+		auto start = std::chrono::steady_clock::now();
+		gravity.load(sphereList);
+		gravity.addPairForces(pairs.data());
+		GLdouble pairSeconds = std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<RealVec3> rows(n, RealVec3(0));
+		start = std::chrono::steady_clock::now();
+		gravity.addRowForces(NULL, 0, n, rows.data());
+		GLdouble rowSeconds = std::chrono::duration<GLdouble>(std::chrono::steady_clock::now() - start).count();
+
+		// largest error relative to the force magnitude on the sample
+		GLdouble scalarError = 0, pairError = 0, rowError = 0;
+		for (GLuint k = 0; k < sampleSize; k++) {
+			GLuint i = k * (n / sampleSize);
+			glm::dvec3 reference(0);
+			for (GLuint j = 0; j < n; j++) {
+				if (j == i) continue;
+				glm::dvec3 diff = glm::dvec3(sphereList.position[j]) - glm::dvec3(sphereList.position[i]);
+				GLdouble d_sqr = glm::dot(diff, diff);
+				reference += (GLdouble)G * sphereList.mass[i] * sphereList.mass[j] / d_sqr * glm::normalize(diff);
+			}
+			GLdouble length = glm::length(reference);
+			if (!scalar.empty())
+				scalarError = glm::max(scalarError, glm::length(glm::dvec3(scalar[i]) - reference) / length);
+			pairError = glm::max(pairError, glm::length(glm::dvec3(pairs[i]) - reference) / length);
+			rowError = glm::max(rowError, glm::length(glm::dvec3(rows[i]) - reference) / length);
+		}
+
+		std::cout << "bodies: " << n;
+		if (!scalar.empty())
+			std::cout << "\tscalar ms: " << scalarSeconds * 1000.0 << "\terror: " << scalarError;
+		std::cout << "\tkernel pairs ms: " << pairSeconds * 1000.0 << "\terror: " << pairError
+			<< "\tkernel rows ms: " << rowSeconds * 1000.0 << "\terror: " << rowError
+			<< "\tpairs/ns: " << 0.5 * n * (n - 1) / (pairSeconds * 1.0E9) << std::endl;
+	}
+	sphereList.clear();
+}
+
+// the sun with the inner planets at their real distances in meters, one year with leapfrog at
+// time steps from a day down to a minute, reporting the largest change of an orbit's radius and of
+// the energy, and the time per step
+// with float positions the rounding of every drift grows as dt shrinks, with double it does not
+// the planets weigh a ton only: G m_sun m_planet with real planet masses exceeds the float range
+GLvoid reportPrecision() {
+	const Real SUN_MASS = Real(1.989E30);
+	const Real PLANET_MASS = Real(1E3);
+	const GLdouble radii[] = { 5.79E10, 1.082E11, 1.496E11, 2.279E11 };
+	const GLdouble year = 365.25 * 86400.0;
+	const GLfloat steps[] = { 86400.0f, 3600.0f, 600.0f, 60.0f };
+	const glm::vec3 ZERO_VEC = glm::vec3(0);
+	forceMode = 1;
+
+	std::cout << "precision: " << (sizeof(Real) == sizeof(GLdouble) ? "double" : "float") << std::endl;
+	for (GLfloat dt : steps) {
+		sphereList.clear();
+		starHandle = sphereList.add(Sphere(ZERO_VEC, ZERO_VEC, ZERO_VEC, ZERO_VEC, ZERO_VEC, SUN_MASS, 0, 0, 7E8f), glm::vec3(0.9, 0.9, 0.0));
+		for (GLuint i = 0; i < 4; i++) {
+			// circular orbits in the xz plane, spread around the sun
+			GLdouble angle = 1.5 * i;
+			GLdouble speed = glm::sqrt((GLdouble)G * SUN_MASS / radii[i]);
+			RealVec3 position = RealVec3(radii[i] * glm::dvec3(glm::sin(angle), 0, glm::cos(angle)));
+			RealVec3 linearVelocity = RealVec3(speed * glm::dvec3(glm::cos(angle), 0, -glm::sin(angle)));
+			sphereList.add(Sphere(position, linearVelocity, ZERO_VEC, ZERO_VEC, ZERO_VEC, PLANET_MASS, 0, 0, 6E6f), glm::vec3(1));
+		}
+
+		GLdouble initialEnergy = totalEnergy();
+		GLdouble maxRadiusError = 0, maxEnergyError = 0;
+		GLuint stepCount = (GLuint)(year / dt);
+		auto start = std::chrono::steady_clock::now();
+		for (GLuint s = 0; s < stepCount; s++) {
+			sphereList.update(dt, SphereStore::LEAPFROG, computeForces);
+			// checking every step would dominate the time for the small steps
+			if (s % 64 != 0 && s + 1 != stepCount) continue;
+			for (GLuint i = 1; i < sphereList.size(); i++) {
+				GLdouble r = glm::distance(glm::dvec3(sphereList.position[i]), glm::dvec3(sphereList.position[0]));
+				maxRadiusError = glm::max(maxRadiusError, glm::abs(r / radii[i - 1] - 1.0));
+			}
+			maxEnergyError = glm::max(maxEnergyError, glm::abs(totalEnergy() / initialEnergy - 1.0));
+		}
+		std::chrono::duration<GLdouble> elapsed = std::chrono::steady_clock::now() - start;
+
+		std::cout << "dt: " << dt << " s"
+			<< "	steps: " << stepCount
+			<< "	max rel. radius error: " << maxRadiusError
+			<< "	max rel. energy error: " << maxEnergyError
+			<< "	us/step: " << elapsed.count() * 1.0E6 / stepCount << std::endl;
+	}
+	sphereList.clear();
+}
+
+// star inside a disk of planets on crossing, slightly inclined orbits, merging on contact
+// usage: Lab5 accretion [bodies] [seconds] [seed]
+// prints the body count and the conservation of mass and momentum once per simulated second
+GLint runAccretion(GLint argc, char** argv)
+{
+	GLuint bodyCount = 2000;
+	GLuint seconds = 10;
+	GLuint seed = 0;
+	if (argc > 2) bodyCount = (GLuint)strtoul(argv[2], NULL, 10);
+	if (argc > 3) seconds = (GLuint)strtoul(argv[3], NULL, 10);
+	if (argc > 4) seed = (GLuint)strtoul(argv[4], NULL, 10);
+	const glm::vec3 ZERO_VEC = glm::vec3(0);
+	const Real M = 1E15;
+	mergeOnContact = true;
+	integrator = SphereStore::LEAPFROG;
+
+	srand(seed);
+	sphereList.clear();
+	sphereList.reserve(bodyCount);
+	starHandle = sphereList.add(Sphere(ZERO_VEC, ZERO_VEC, ZERO_VEC, ZERO_VEC, ZERO_VEC, M, 0, 0, 10), glm::vec3(0.9, 0.9, 0.0));
+	for (GLuint i = 1; i < bodyCount; i++) {
+		Real d = glm::linearRand(20.0f, 200.0f);
+		GLfloat angle = glm::linearRand(0.0f, 2.0f * glm::pi<GLfloat>());
+		GLfloat inclination = glm::linearRand(-0.05f, 0.05f);
+		// between 0.8 and 1.2 times the speed of a circular orbit, so the orbits cross
+		Real speed = glm::sqrt(G * M / d) * glm::linearRand(0.8f, 1.2f);
+		RealVec3 position = d * RealVec3(glm::sin(angle), 0, glm::cos(angle));
+		RealVec3 linearVelocity = speed * RealVec3(glm::cos(angle), glm::sin(inclination), -glm::sin(angle));
+		sphereList.add(Sphere(position, linearVelocity, ZERO_VEC, ZERO_VEC, ZERO_VEC, 10, 0, 0, 1), glm::linearRand(glm::vec3(0.0f), glm::vec3(1.0f)));
+	}
+
+	// total mass and momentum in double, the momentum error is relative to the sum of |m v|
+	auto totals = [](GLdouble& mass, glm::dvec3& momentum, GLdouble& scale) {
+		mass = 0;
+		momentum = glm::dvec3(0);
+		scale = 0;
+		for (GLuint i = 0; i < sphereList.size(); i++) {
+			glm::dvec3 p = (GLdouble)sphereList.mass[i] * glm::dvec3(sphereList.linearVelocity[i]);
+			mass += sphereList.mass[i];
+			momentum += p;
+			scale += glm::length(p);
+		}
+	};
+	GLdouble initialMass, scale, mass, unused;
+	glm::dvec3 initialMomentum, momentum;
+	totals(initialMass, initialMomentum, scale);
+	size_t capacity = sphereList.position.capacity();
+
+	GLuint stepsPerSecond = (GLuint)(1.0f / FIXED_DT + 0.5f);
+	for (GLuint second = 1; second <= seconds; second++) {
+		auto start = std::chrono::steady_clock::now();
+		for (GLuint step = 0; step < stepsPerSecond; step++)
+			simulate(FIXED_DT);
+		std::chrono::duration<GLdouble> elapsed = std::chrono::steady_clock::now() - start;
+
+		totals(mass, momentum, unused);
+		std::cout << "time: " << second
+			<< "\tbodies: " << sphereList.size()
+			<< "\trel. mass error: " << glm::abs(mass / initialMass - 1.0)
+			<< "\trel. momentum error: " << glm::length(momentum - initialMomentum) / scale
+			<< "\tsteps/s: " << stepsPerSecond / elapsed.count() << std::endl;
+	}
+	std::cout << "reallocated: " << (sphereList.position.capacity() != capacity ? "yes" : "no") << std::endl;
+	mergeOnContact = false;
+	integrator = SphereStore::EULER;
+	return 0;
 }
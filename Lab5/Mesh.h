@@ -31,6 +31,13 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// per-instance attributes for instanced drawing
+// model occupies vertex attribute locations 7-10, color location 11
+struct InstanceData {
+    glm::mat4 Model;
+    glm::vec3 Color;
+};
+
 struct Texture {
     unsigned int id;
     string type;
@@ -53,21 +60,110 @@ public:
         this->textures = textures;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), static_cast<unsigned int>(this->vertices.size()), this->indices.data(), static_cast<unsigned int>(this->indices.size()));
+        setupSamplerNames();
+    }
+
+    // constructor for data that is only uploaded to the GPU, e.g. from a mapped mesh cache
+    // vertices and indices stay empty
+    Mesh(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount, vector<Texture> textures)
+    {
+        this->textures = textures;
+
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
+        setupSamplerNames();
     }
 
     // render the mesh
     void Draw(Shader& shader)
+    {
+        bindTextures(shader);
+
+        // draw mesh
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render count copies of the mesh in one draw call
+    // instanceVBO holds count InstanceData records
+    void DrawInstanced(Shader& shader, unsigned int instanceVBO, unsigned int count)
+    {
+        bindTextures(shader);
+
+        glBindVertexArray(VAO);
+        if (instanceVBO != boundInstanceVBO)
+            setupInstanceAttributes(instanceVBO);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, count);
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    // render data 
+    unsigned int VBO, EBO;
+    unsigned int indexCount;
+    // uniform names of the texture samplers, and their locations in samplerShader
+    vector<string> samplerNames;
+    vector<int> samplerLocations;
+    unsigned int samplerShader = 0;
+    // instance buffer the per-instance attributes of VAO currently point to
+    unsigned int boundInstanceVBO = 0;
+
+    void bindTextures(Shader& shader)
     {
         // bind appropriate textures
+        // sampler locations are looked up once per shader
+        if (shader.ID != samplerShader)
+        {
+            samplerLocations.resize(textures.size());
+            for (unsigned int i = 0; i < textures.size(); i++)
+                samplerLocations[i] = shader.location(samplerNames[i]);
+            samplerShader = shader.ID;
+        }
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit
+            shader.setInt(samplerLocations[i], i);
+            // and finally bind the texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+    // point the per-instance attributes of VAO (which must be bound) to instanceVBO
+    void setupInstanceAttributes(unsigned int instanceVBO)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        // model matrix, one column per attribute
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(7 + i);
+            glVertexAttribPointer(7 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, Model) + i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(7 + i, 1);
+        }
+        // color
+        glEnableVertexAttribArray(11);
+        glVertexAttribPointer(11, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, Color));
+        glVertexAttribDivisor(11, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        boundInstanceVBO = instanceVBO;
+    }
+
+    // name the sampler of each texture by its type and number (the N in diffuse_textureN)
+    void setupSamplerNames()
+    {
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr = 1;
         unsigned int heightNr = 1;
+        samplerNames.resize(textures.size());
         for (unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
             if (name == "texture_diffuse")
@@ -78,29 +174,15 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to string
             else if (name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            samplerNames[i] = name + number;
         }
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount)
     {
+        this->indexCount = indexCount;
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -112,10 +194,10 @@ private:
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
         // vertex Positions
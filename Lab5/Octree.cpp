@@ -0,0 +1,187 @@
+#include "Octree.h"
+#include <algorithm>
+
+
+Octree::Octree() : theta(0.5f) {}
+
+Octree::Octree(GLfloat theta) : theta(theta) {}
+
+// rebuild the tree around the current positions of all bodies
+void Octree::build(const SphereStore& bodies)
+{
+	nodes.clear();
+	bodyIndex.resize(bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++)
+		bodyIndex[i] = (GLuint)i;
+	if (bodies.size() == 0) return;
+
+	// root cube encloses all bodies
+	RealVec3 minPos = bodies.position[0];
+	RealVec3 maxPos = bodies.position[0];
+	for (size_t i = 1; i < bodies.size(); i++) {
+		minPos = glm::min(minPos, bodies.position[i]);
+		maxPos = glm::max(maxPos, bodies.position[i]);
+	}
+	RealVec3 extent = maxPos - minPos;
+
+	OctreeNode root;
+	root.center = (minPos + maxPos) * Real(0.5);
+	root.halfWidth = glm::max(glm::max(extent.x, extent.y), extent.z) * Real(0.5) + Real(1E-3);
+	root.firstChild = -1;
+	root.begin = 0;
+	root.end = (GLuint)bodies.size();
+	nodes.push_back(root);
+
+	subdivide(bodies, 0, 0);
+
+	bodySlot.resize(bodies.size());
+	for (size_t k = 0; k < bodyIndex.size(); k++)
+		bodySlot[bodyIndex[k]] = (GLuint)k;
+}
+
+// children come after their parent in nodes, so walking backwards finishes every child first
+void Octree::refit(const SphereStore& bodies)
+{
+	for (size_t n = nodes.size(); n-- > 0;) {
+		OctreeNode& node = nodes[n];
+		if (node.begin == node.end) continue;
+		Real mass = 0;
+		RealVec3 weightedPosition(0);
+		if (node.firstChild < 0) {
+			node.boundMin = node.boundMax = bodies.position[bodyIndex[node.begin]];
+			for (GLuint k = node.begin; k < node.end; k++) {
+				GLuint b = bodyIndex[k];
+				mass += bodies.mass[b];
+				weightedPosition += bodies.mass[b] * bodies.position[b];
+				node.boundMin = glm::min(node.boundMin, bodies.position[b]);
+				node.boundMax = glm::max(node.boundMax, bodies.position[b]);
+			}
+		}
+		else {
+			GLboolean first = GL_TRUE;
+			for (GLint c = 0; c < 8; c++) {
+				const OctreeNode& child = nodes[node.firstChild + c];
+				if (child.begin == child.end) continue;
+				mass += child.mass;
+				weightedPosition += child.mass * child.centerOfMass;
+				node.boundMin = first ? child.boundMin : glm::min(node.boundMin, child.boundMin);
+				node.boundMax = first ? child.boundMax : glm::max(node.boundMax, child.boundMax);
+				first = GL_FALSE;
+			}
+		}
+		node.mass = mass;
+		node.centerOfMass = mass > 0 ? weightedPosition / mass : node.center;
+	}
+}
+
+// accumulate mass of a node and split it into 8 children if it holds too many bodies
+void Octree::subdivide(const SphereStore& bodies, GLuint node, GLuint depth)
+{
+	GLuint begin = nodes[node].begin;
+	GLuint end = nodes[node].end;
+
+	// total mass, center of mass and bounding box of all bodies in the node
+	Real mass = 0;
+	RealVec3 weightedPosition(0);
+	RealVec3 boundMin = bodies.position[bodyIndex[begin]];
+	RealVec3 boundMax = boundMin;
+	for (GLuint k = begin; k < end; k++) {
+		GLuint b = bodyIndex[k];
+		mass += bodies.mass[b];
+		weightedPosition += bodies.mass[b] * bodies.position[b];
+		boundMin = glm::min(boundMin, bodies.position[b]);
+		boundMax = glm::max(boundMax, bodies.position[b]);
+	}
+	nodes[node].mass = mass;
+	nodes[node].boundMin = boundMin;
+	nodes[node].boundMax = boundMax;
+	nodes[node].centerOfMass = mass > 0 ? weightedPosition / mass : nodes[node].center;
+
+	if (end - begin <= LEAF_SIZE || depth >= MAX_DEPTH) return;
+
+	// partition bodies into octants: first by x, then each half by y, then each quarter by z
+	RealVec3 center = nodes[node].center;
+	GLuint* first = bodyIndex.data() + begin;
+	GLuint* last = bodyIndex.data() + end;
+	GLuint* split[9];
+	split[0] = first;
+	split[8] = last;
+	split[4] = std::partition(first, last, [&](GLuint b) { return bodies.position[b].x < center.x; });
+	for (GLint h = 0; h < 8; h += 4)
+		split[h + 2] = std::partition(split[h], split[h + 4], [&](GLuint b) { return bodies.position[b].y < center.y; });
+	for (GLint q = 0; q < 8; q += 2)
+		split[q + 1] = std::partition(split[q], split[q + 2], [&](GLuint b) { return bodies.position[b].z < center.z; });
+
+	// child c covers octant with x bit 4, y bit 2 and z bit 1 of c
+	Real childHalfWidth = nodes[node].halfWidth * Real(0.5);
+	GLint firstChild = (GLint)nodes.size();
+	nodes[node].firstChild = firstChild;
+	for (GLint c = 0; c < 8; c++) {
+		OctreeNode child;
+		child.center = center + childHalfWidth * RealVec3(
+			(c & 4) ? 1 : -1,
+			(c & 2) ? 1 : -1,
+			(c & 1) ? 1 : -1);
+		child.halfWidth = childHalfWidth;
+		child.firstChild = -1;
+		child.begin = (GLuint)(split[c] - bodyIndex.data());
+		child.end = (GLuint)(split[c + 1] - bodyIndex.data());
+		nodes.push_back(child);
+	}
+	for (GLint c = 0; c < 8; c++) {
+		if (nodes[firstChild + c].begin != nodes[firstChild + c].end)
+			subdivide(bodies, firstChild + c, depth + 1);
+	}
+}
+
+// gravitational force on body i from all other bodies
+// must be called after build() with the same bodies
+// nodes are opened by the size of the box around their bodies rather than their cube, which
+// after refit() no longer has to enclose them
+RealVec3 Octree::computeForce(const SphereStore& bodies, GLuint i, Real G) const
+{
+	RealVec3 force(0);
+	if (nodes.empty()) return force;
+
+	RealVec3 position = bodies.position[i];
+	Real mass = bodies.mass[i];
+	Real theta2 = theta * theta;
+	GLuint slot = bodySlot[i];
+
+	GLuint stack[8 * (MAX_DEPTH + 1)];
+	GLuint top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const OctreeNode& node = nodes[stack[--top]];
+		if (node.begin == node.end) continue;
+
+		if (node.firstChild < 0) {
+			// leaf: sum over its bodies directly
+			for (GLuint k = node.begin; k < node.end; k++) {
+				GLuint j = bodyIndex[k];
+				if (j == i) continue;
+				RealVec3 diff = bodies.position[j] - position;
+				Real d_sqr = glm::dot(diff, diff);
+				force += G * mass * bodies.mass[j] / d_sqr * glm::normalize(diff);
+			}
+			continue;
+		}
+
+		RealVec3 diff = node.centerOfMass - position;
+		Real d_sqr = glm::dot(diff, diff);
+		RealVec3 extent = node.boundMax - node.boundMin;
+		Real width = glm::max(glm::max(extent.x, extent.y), extent.z);
+		// a node holding body i would count its mass in the center of mass
+		GLboolean holds = slot >= node.begin && slot < node.end;
+		GLboolean inside = glm::all(glm::greaterThanEqual(position, node.boundMin)) && glm::all(glm::lessThanEqual(position, node.boundMax));
+		if (!holds && !inside && width * width < theta2 * d_sqr) {
+			// far enough away: use the node's center of mass
+			force += G * mass * node.mass / d_sqr * glm::normalize(diff);
+		}
+		else {
+			for (GLint c = 0; c < 8; c++)
+				stack[top++] = node.firstChild + c;
+		}
+	}
+	return force;
+}
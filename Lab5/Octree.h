@@ -0,0 +1,50 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/constants.hpp>
+#include <vector>
+#include "RigidBody.h"
+
+// a cube of space holding either up to LEAF_SIZE bodies or 8 child cubes
+struct OctreeNode {
+	RealVec3 center;
+	Real halfWidth;
+	RealVec3 centerOfMass;
+	Real mass;
+	// box around the current positions of the bodies, follows them in refit() while the cube stays
+	RealVec3 boundMin;
+	RealVec3 boundMax;
+	GLint firstChild; // index of the first of 8 consecutive children, -1 for leaves
+	GLuint begin; // bodies of this node are bodyIndex[begin] ... bodyIndex[end - 1]
+	GLuint end;
+};
+
+// Barnes-Hut approximation of the gravitational forces between spheres
+// a node seen at an angle smaller than theta is treated as a single body at its center of mass
+class Octree {
+public:
+	static const GLuint LEAF_SIZE = 8;
+	static const GLuint MAX_DEPTH = 32;
+
+	std::vector<OctreeNode> nodes;
+	std::vector<GLuint> bodyIndex;
+	// slot of body i in bodyIndex, so bodyIndex[bodySlot[i]] == i
+	std::vector<GLuint> bodySlot;
+	GLfloat theta;
+
+	Octree();
+	Octree(GLfloat theta);
+
+	void build(const SphereStore& bodies);
+	// recompute the masses, centers of mass and bounding boxes of all nodes from the current
+	// positions of the bodies they were built with, without sorting the bodies again
+	// the boxes grow as the bodies of a node spread, so the tree stays correct but opens more
+	// nodes the further the bodies moved since build()
+	void refit(const SphereStore& bodies);
+	RealVec3 computeForce(const SphereStore& bodies, GLuint i, Real G) const;
+
+private:
+	void subdivide(const SphereStore& bodies, GLuint node, GLuint depth);
+};
@@ -1,13 +1,14 @@
 #include "RigidBody.h"
+#include <algorithm>
 
 
 RigidBody::RigidBody(
-	glm::vec3 position,
-	glm::vec3 linearVelocity,
+	RealVec3 position,
+	RealVec3 linearVelocity,
 	glm::vec3 rotation,
 	glm::vec3 rotationVelocity,
-	glm::vec3 force,
-	GLfloat mass,
+	RealVec3 force,
+	Real mass,
 	GLfloat restitution,
 	GLfloat friction)
 {
@@ -21,35 +22,12 @@ RigidBody::RigidBody(
 	this->friction = friction;
 }
 
-void RigidBody::update(GLfloat dt)
-{
-	linearVelocity += force / mass * dt;
-	position += linearVelocity * dt;
-	rotation += rotationVelocity * dt;
-	force = glm::vec3(0, 0, 0) * mass;
-}
-
-void RigidBody::move(glm::vec3 amount)
-{
-	position += amount;
-}
-
-void RigidBody::setPosition(glm::vec3 position)
-{
-	this->position = position;
-}
-
-void RigidBody::applyForce(glm::vec3 force)
-{
-	this->force += force;
-}
-
-Sphere::Sphere(glm::vec3 position,
-	glm::vec3 linearVelocity,
+Sphere::Sphere(RealVec3 position,
+	RealVec3 linearVelocity,
 	glm::vec3 rotation,
 	glm::vec3 rotationVelocity,
-	glm::vec3 force,
-	GLfloat mass,
+	RealVec3 force,
+	Real mass,
 	GLfloat restitution,
 	GLfloat friction,
 	GLfloat radius)
@@ -62,68 +40,274 @@ Sphere::Sphere(glm::vec3 position,
 		restitution,
 		friction), radius(radius) {}
 
-bool Sphere::intersect(Sphere a, Sphere b, glm::vec3& normal, GLfloat& depth)
+// add a body and return its handle
+GLuint SphereStore::add(const Sphere& s, glm::vec3 color)
 {
-	normal = glm::vec3(0.0);
-	depth = 0.0f;
+	GLuint i = (GLuint)size();
+	position.push_back(s.position);
+	linearVelocity.push_back(s.linearVelocity);
+	rotation.push_back(s.rotation);
+	rotationVelocity.push_back(s.rotationVelocity);
+	force.push_back(s.force);
+	mass.push_back(s.mass);
+	restitution.push_back(s.restitution);
+	friction.push_back(s.friction);
+	radius.push_back(s.radius);
+	this->color.push_back(color);
 
-	GLfloat distance = glm::distance(a.position, b.position);
-	GLfloat radii = a.radius + b.radius;
+	// reuse handles of removed bodies
+	GLuint h;
+	if (!freeHandles.empty()) {
+		h = freeHandles.back();
+		freeHandles.pop_back();
+		indexOf[h] = i;
+	}
+	else {
+		h = (GLuint)indexOf.size();
+		indexOf.push_back(i);
+	}
+	handleOf.push_back(h);
+	return h;
+}
 
-	if (distance >= radii)
-	{
-		return false;
+// remove a body by moving the last body into its place
+void SphereStore::remove(GLuint handle)
+{
+	GLuint i = indexOf[handle];
+	GLuint last = (GLuint)size() - 1;
+	position[i] = position[last];
+	linearVelocity[i] = linearVelocity[last];
+	rotation[i] = rotation[last];
+	rotationVelocity[i] = rotationVelocity[last];
+	force[i] = force[last];
+	mass[i] = mass[last];
+	restitution[i] = restitution[last];
+	friction[i] = friction[last];
+	radius[i] = radius[last];
+	color[i] = color[last];
+	handleOf[i] = handleOf[last];
+	indexOf[handleOf[i]] = i;
+
+	position.pop_back();
+	linearVelocity.pop_back();
+	rotation.pop_back();
+	rotationVelocity.pop_back();
+	force.pop_back();
+	mass.pop_back();
+	restitution.pop_back();
+	friction.pop_back();
+	radius.pop_back();
+	color.pop_back();
+	handleOf.pop_back();
+	freeHandles.push_back(handle);
+}
+
+void SphereStore::merge(GLuint a, GLuint b)
+{
+	Real m = mass[a] + mass[b];
+	position[a] = (mass[a] * position[a] + mass[b] * position[b]) / m;
+	linearVelocity[a] = (mass[a] * linearVelocity[a] + mass[b] * linearVelocity[b]) / m;
+	force[a] += force[b];
+	radius[a] = glm::pow(radius[a] * radius[a] * radius[a] + radius[b] * radius[b] * radius[b], 1.0f / 3.0f);
+	mass[a] = m;
+	mass[b] = 0;
+}
+
+GLuint SphereStore::compact()
+{
+	GLuint n = (GLuint)size();
+	GLuint kept = 0;
+	for (GLuint i = 0; i < n; i++) {
+		if (mass[i] == 0) {
+			freeHandles.push_back(handleOf[i]);
+			continue;
+		}
+		if (kept != i) {
+			position[kept] = position[i];
+			linearVelocity[kept] = linearVelocity[i];
+			rotation[kept] = rotation[i];
+			rotationVelocity[kept] = rotationVelocity[i];
+			force[kept] = force[i];
+			mass[kept] = mass[i];
+			restitution[kept] = restitution[i];
+			friction[kept] = friction[i];
+			radius[kept] = radius[i];
+			color[kept] = color[i];
+			handleOf[kept] = handleOf[i];
+			indexOf[handleOf[kept]] = kept;
+		}
+		kept++;
 	}
 
-	normal = glm::normalize(a.position - b.position);
-	depth = radii - distance;
+	// shrinking never reallocates
+	position.resize(kept);
+	linearVelocity.resize(kept);
+	rotation.resize(kept);
+	rotationVelocity.resize(kept);
+	force.resize(kept);
+	mass.resize(kept);
+	restitution.resize(kept);
+	friction.resize(kept);
+	radius.resize(kept);
+	color.resize(kept);
+	handleOf.resize(kept);
+	return n - kept;
+}
 
-	return true;
+void SphereStore::clear()
+{
+	position.clear();
+	linearVelocity.clear();
+	rotation.clear();
+	rotationVelocity.clear();
+	force.clear();
+	mass.clear();
+	restitution.clear();
+	friction.clear();
+	radius.clear();
+	color.clear();
+	indexOf.clear();
+	handleOf.clear();
+	freeHandles.clear();
 }
 
-bool Sphere::intersectBound(glm::vec3& normal, glm::vec3& depth)
+void SphereStore::reserve(size_t n)
 {
-	normal = glm::vec3(0.0);
-	depth = glm::vec3(0.0);
+	position.reserve(n);
+	linearVelocity.reserve(n);
+	rotation.reserve(n);
+	rotationVelocity.reserve(n);
+	force.reserve(n);
+	mass.reserve(n);
+	restitution.reserve(n);
+	friction.reserve(n);
+	radius.reserve(n);
+	color.reserve(n);
+	handleOf.reserve(n);
+	indexOf.reserve(n);
+}
+
+// integrate all bodies with explicit Euler and reset their forces
+void SphereStore::update(GLfloat dt)
+{
+	update(dt, 0, (GLuint)size());
+}
 
-	bool isHit = false;
+// update only bodies begin ... end - 1
+void SphereStore::update(GLfloat dt, GLuint begin, GLuint end)
+{
+	Real h = dt;
+	for (GLuint i = begin; i < end; i++) {
+		linearVelocity[i] += force[i] / mass[i] * h;
+		position[i] += linearVelocity[i] * h;
+		rotation[i] += rotationVelocity[i] * dt;
+		force[i] = RealVec3(0);
+	}
+}
 
-	GLfloat dist;
-	/*dist = position.x - (-15) - radius;
-	if (dist < 0) {
-		isHit = true;
-		normal.x += 1;
-		depth.x += dist; 
+void SphereStore::update(GLfloat dt, Integrator integrator, const std::function<void()>& computeForces)
+{
+	size_t n = size();
+	Real h = dt;
+	switch (integrator) {
+	case EULER:
+		std::fill(force.begin(), force.end(), RealVec3(0));
+		computeForces();
+		update(dt);
+		return;
+	case LEAPFROG:
+		drift(Real(0.5) * h);
+		kick(h, computeForces);
+		drift(Real(0.5) * h);
+		break;
+	case YOSHIDA4: {
+		// w1 = 1 / (2 - 2^(1/3)), w0 = 1 - 2 w1
+		const GLdouble w1 = 1.0 / (2.0 - glm::pow(2.0, 1.0 / 3.0));
+		const GLdouble w0 = 1.0 - 2.0 * w1;
+		drift(Real(0.5 * w1) * h);
+		kick(Real(w1) * h, computeForces);
+		drift(Real(0.5 * (w0 + w1)) * h);
+		kick(Real(w0) * h, computeForces);
+		drift(Real(0.5 * (w0 + w1)) * h);
+		kick(Real(w1) * h, computeForces);
+		drift(Real(0.5 * w1) * h);
+		break;
 	}
-	dist = 15 - position.x - radius;
-	if (dist < 0) {
-		isHit = true;
-		normal.x -= 1;
-		depth.x += dist; 
+	case RK4: {
+		startPosition = position;
+		startVelocity = linearVelocity;
+		positionSum.assign(n, RealVec3(0));
+		velocitySum.assign(n, RealVec3(0));
+		// stage k is evaluated at start + offset[k] * dt * (derivatives of stage k - 1) and has weight weight[k]
+		const Real offset[4] = { 0, 0.5, 0.5, 1 };
+		const Real weight[4] = { 1, 2, 2, 1 };
+		for (GLuint k = 0; k < 4; k++) {
+			// position and linearVelocity hold the state of stage k
+			std::fill(force.begin(), force.end(), RealVec3(0));
+			computeForces();
+			for (size_t i = 0; i < n; i++) {
+				RealVec3 acceleration = force[i] / mass[i];
+				positionSum[i] += weight[k] * linearVelocity[i];
+				velocitySum[i] += weight[k] * acceleration;
+				if (k < 3) {
+					position[i] = startPosition[i] + offset[k + 1] * h * linearVelocity[i];
+					linearVelocity[i] = startVelocity[i] + offset[k + 1] * h * acceleration;
+				}
+			}
+		}
+		for (size_t i = 0; i < n; i++) {
+			position[i] = startPosition[i] + h / 6 * positionSum[i];
+			linearVelocity[i] = startVelocity[i] + h / 6 * velocitySum[i];
+		}
+		break;
 	}
-	dist = position.y - 0 - radius;
-	if (dist < 0) {
-		isHit = true;
-		normal.y += 1;
-		depth.y += dist; 
 	}
-	dist = 30 - position.y - radius;
-	if (dist < 0) {
-		isHit = true;
-		normal.y -= 1;
-		depth.y += dist;
+	for (size_t i = 0; i < n; i++) {
+		rotation[i] += rotationVelocity[i] * dt;
+		force[i] = RealVec3(0);
 	}
-	dist = position.z - (-15) - radius;
-	if (dist < 0) {
-		isHit = true;
-		normal.z += 1;
-		depth.z += dist; 
+}
+
+GLuint SphereStore::forceEvaluations(Integrator integrator)
+{
+	switch (integrator) {
+	case YOSHIDA4: return 3;
+	case RK4: return 4;
+	default: return 1;
+	}
+}
+
+// move all bodies along their velocity
+void SphereStore::drift(Real dt)
+{
+	for (size_t i = 0; i < size(); i++)
+		position[i] += linearVelocity[i] * dt;
+}
+
+// change all velocities by the forces at the current positions
+void SphereStore::kick(Real dt, const std::function<void()>& computeForces)
+{
+	std::fill(force.begin(), force.end(), RealVec3(0));
+	computeForces();
+	for (size_t i = 0; i < size(); i++)
+		linearVelocity[i] += force[i] / mass[i] * dt;
+}
+
+bool SphereStore::intersect(GLuint a, GLuint b, RealVec3& normal, Real& depth) const
+{
+	normal = RealVec3(0.0);
+	depth = 0;
+
+	Real distance = glm::distance(position[a], position[b]);
+	Real radii = radius[a] + radius[b];
+
+	if (distance >= radii)
+	{
+		return false;
 	}
-	dist = 15 - position.z - radius;
-	if (dist < 0) {
-		isHit = true;
-		normal.z -= 1;
-		depth.z += dist;
-	}*/
-	return isHit;
+
+	normal = glm::normalize(position[a] - position[b]);
+	depth = radii - distance;
+
+	return true;
 }
@@ -4,49 +4,133 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/constants.hpp>
+#include <functional>
+#include <vector>
 
+// precision of positions, velocities, forces and masses, define LAB5_DOUBLE_PRECISION to
+// simulate in double, e.g. astronomically scaled systems where float rounding breaks orbits
+// rendering stays in float, relative to the camera
+#ifdef LAB5_DOUBLE_PRECISION
+typedef GLdouble Real;
+#else
+typedef GLfloat Real;
+#endif
+typedef glm::vec<3, Real> RealVec3;
 
 class RigidBody
 {
 public: 
-	glm::vec3 position;
-	glm::vec3 linearVelocity;
+	RealVec3 position;
+	RealVec3 linearVelocity;
 	glm::vec3 rotation;
 	glm::vec3 rotationVelocity;
-	glm::vec3 force;
-	GLfloat mass;
+	RealVec3 force;
+	Real mass;
 	GLfloat restitution;
 	GLfloat friction;
 
 	RigidBody(
-		glm::vec3 position,
-		glm::vec3 linearVelocity,
+		RealVec3 position,
+		RealVec3 linearVelocity,
 		glm::vec3 rotation,
 		glm::vec3 rotationVelocity,
-		glm::vec3 force,
-		GLfloat mass,
+		RealVec3 force,
+		Real mass,
 		GLfloat restitution,
 		GLfloat friction);
-
-	void update(GLfloat dt);
-	void move(glm::vec3 amount);
-	void setPosition(glm::vec3 position);
-	void applyForce(glm::vec3 force);
-	
 };
 
 class Sphere : public RigidBody {
 public:
 	GLfloat radius;
-	Sphere(glm::vec3 position,
-		glm::vec3 linearVelocity,
+	Sphere(RealVec3 position,
+		RealVec3 linearVelocity,
 		glm::vec3 rotation,
 		glm::vec3 rotationVelocity,
-		glm::vec3 force,
-		GLfloat mass,
+		RealVec3 force,
+		Real mass,
 		GLfloat restitution,
 		GLfloat friction,
 		GLfloat radius);
-	bool static intersect(Sphere a, Sphere b, glm::vec3& normal, GLfloat& depth);
-	bool intersectBound(glm::vec3& normal, glm::vec3& depth);
+};
+
+// structure-of-arrays storage of spheres: one contiguous array per field
+// bodies are addressed by index i in [0, size()), which changes when bodies are removed
+// handles returned by add() stay valid until the body is removed
+class SphereStore {
+public:
+	// integration schemes of update, with the number of force evaluations per step
+	enum Integrator {
+		EULER,		// semi-implicit Euler, 1, first order
+		LEAPFROG,	// drift-kick-drift leapfrog (position Verlet), 1, second order, symplectic
+		YOSHIDA4,	// three leapfrog steps with Yoshida's weights, 3, fourth order, symplectic
+		RK4			// classic Runge-Kutta, 4, fourth order, not symplectic
+	};
+
+	std::vector<RealVec3> position;
+	std::vector<RealVec3> linearVelocity;
+	std::vector<glm::vec3> rotation;
+	std::vector<glm::vec3> rotationVelocity;
+	std::vector<RealVec3> force;
+	std::vector<Real> mass;
+	std::vector<GLfloat> restitution;
+	std::vector<GLfloat> friction;
+	std::vector<GLfloat> radius;
+	std::vector<glm::vec3> color;
+
+	GLuint add(const Sphere& s, glm::vec3 color);
+	void remove(GLuint handle);
+	void clear();
+	void reserve(size_t n);
+	// combine body b into body a: the masses and momenta add up, a moves to the common center
+	// of mass and gets the volume of both, b is left without mass until compact() removes it
+	void merge(GLuint a, GLuint b);
+	// remove all bodies without mass, keep the order of the others and return how many were removed
+	// the arrays shrink in place, their capacity stays
+	GLuint compact();
+
+	size_t size() const {
+		return position.size();
+	}
+	// current index of the body with this handle
+	GLuint index(GLuint handle) const {
+		return indexOf[handle];
+	}
+	// handle of the body at index i
+	GLuint handle(GLuint i) const {
+		return handleOf[i];
+	}
+
+	void move(GLuint i, const RealVec3& amount) {
+		position[i] += amount;
+	}
+	void setPosition(GLuint i, const RealVec3& position) {
+		this->position[i] = position;
+	}
+	void applyForce(GLuint i, const RealVec3& force) {
+		this->force[i] += force;
+	}
+
+	void update(GLfloat dt);
+	void update(GLfloat dt, GLuint begin, GLuint end);
+	// advance all bodies by dt with the given scheme
+	// computeForces must add the forces at the current positions to force, it is called once per stage
+	// with force set to zero, and force is zero again after the step
+	void update(GLfloat dt, Integrator integrator, const std::function<void()>& computeForces);
+	static GLuint forceEvaluations(Integrator integrator);
+	bool intersect(GLuint a, GLuint b, RealVec3& normal, Real& depth) const;
+
+private:
+	// state at the start of an RK4 step and the weighted sums of its stages
+	std::vector<RealVec3> startPosition;
+	std::vector<RealVec3> startVelocity;
+	std::vector<RealVec3> positionSum;
+	std::vector<RealVec3> velocitySum;
+
+	void drift(Real dt);
+	void kick(Real dt, const std::function<void()>& computeForces);
+
+	std::vector<GLuint> indexOf;
+	std::vector<GLuint> handleOf;
+	std::vector<GLuint> freeHandles;
 };
\ No newline at end of file
@@ -18,22 +18,26 @@ struct Light {
 in vec3 FragPos;  
 in vec3 Normal;  
 in vec2 TexCoords;
+in vec3 InstanceColor;
   
 uniform vec3 viewPos;
 uniform Material material;
+// instances take their diffuse color from InstanceColor instead of material
+uniform int instanced = 0;
 uniform Light lights[2];
 uniform int inverseNormal = 0;
 
-vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor);
 
 void main()
 {
     vec3 viewDir = normalize(viewPos - FragPos);
     vec3 norm = normalize(Normal);
     if (inverseNormal == 1) norm = -norm;
+    vec3 diffuseColor = instanced == 1 ? InstanceColor : material.diffuse;
     vec3 result = vec3(0,0,0);
     for(int i = 0; i < 2; i++)
-        result += CalcPointLight(lights[i], norm, FragPos, viewDir);    
+        result += CalcPointLight(lights[i], norm, FragPos, viewDir, diffuseColor);    
     //if (texture(texture_diffuse1, TexCoords) == vec4(vec3(0.0), 1.0)) {
     FragColor = vec4(result, 1.0);
     //}
@@ -42,7 +46,7 @@ void main()
 } 
 
 // calculates the color when using a point light.
-vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
@@ -54,8 +58,8 @@ vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.0;    
     // combine results
-    vec3 ambient = light.ambient * material.diffuse;
-    vec3 diffuse = light.diffuse * diff * material.diffuse;
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
     vec3 specular = light.specular * spec * material.specular;
     ambient *= attenuation;
     diffuse *= attenuation;